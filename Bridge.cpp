@@ -63,50 +63,52 @@ bool Bridge::lift() {
 }
 
 std::string Bridge::get_citygml() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<brg:Bridge gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<brg:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<brg:Bridge gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<brg:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</brg:lod1MultiSurface>" << std::endl;
-  ss << "</brg:Bridge>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</brg:lod1MultiSurface>\n";
+  ss << "</brg:Bridge>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
+std::string Bridge::get_cityjson(ObjVertexTable &dPts) {
+  return get_cityjson_object("Bridge", get_cityjson_multisurface(dPts));
+}
+
 std::string Bridge::get_citygml_imgeo() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<bri:BridgeConstructionElement gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<bri:lod1Geometry>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<bri:BridgeConstructionElement gml:id=\"" << this->get_id() << "\">\n";
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<bri:lod1Geometry>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</bri:lod1Geometry>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</bri:lod1Geometry>\n";
   std::string attribute;
   if (get_attribute("bgt-type", attribute)) {
-    ss << "<bri:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverbruggingsdeel\">" << attribute << "</bri:function>" << std::endl;
+    ss << "<bri:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverbruggingsdeel\">" << attribute << "</bri:function>\n";
   }
   if (get_attribute("hoortbijtypeoverbrugging", attribute)) {
-    ss << "<imgeo:hoortBijTypeOverbrugging codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverbrugging\">" << attribute << "</imgeo:hoortBijTypeOverbrugging>" << std::endl;
+    ss << "<imgeo:hoortBijTypeOverbrugging codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverbrugging\">" << attribute << "</imgeo:hoortBijTypeOverbrugging>\n";
   }
   if (get_attribute("overbruggingisbeweegbaar", attribute)) {
-    ss << "<imgeo:overbruggingIsBeweegbaar>" << attribute << "</imgeo:overbruggingIsBeweegbaar>" << std::endl;
+    ss << "<imgeo:overbruggingIsBeweegbaar>" << attribute << "</imgeo:overbruggingIsBeweegbaar>\n";
   }
-  ss << "</bri:BridgeConstructionElement>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "</bri:BridgeConstructionElement>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
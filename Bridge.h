@@ -39,6 +39,7 @@ public:
   bool          add_elevation_point(Point2 &p, double z, float radius, LAS14Class lasclass, bool lastreturn);
   std::string   get_citygml();
   std::string   get_citygml_imgeo();
+  std::string   get_cityjson(ObjVertexTable &dPts);
   std::string   get_mtl();
   bool          get_shape(OGRLayer * layer);
   TopoClass     get_class();
@@ -43,12 +43,10 @@ bool Building::lift() {
   //-- for the ground
   if (_zvaluesground.empty() == false) {
     //-- Only use ground points for base height calculation
-    std::nth_element(_zvaluesground.begin(), _zvaluesground.begin() + (_zvaluesground.size() * _heightref_base), _zvaluesground.end());
-    _height_base = _zvaluesground[_zvaluesground.size() * _heightref_base];
+    _height_base = _zvaluesground.get_percentile(_heightref_base);
   }
   else if (_zvaluesinside.empty() == false) {
-    std::nth_element(_zvaluesinside.begin(), _zvaluesinside.begin() + (_zvaluesinside.size() * _heightref_base), _zvaluesinside.end());
-    _height_base = _zvaluesinside[_zvaluesinside.size() * _heightref_base];
+    _height_base = _zvaluesinside.get_percentile(_heightref_base);
   }
   else {
     _height_base = 0;
@@ -66,10 +64,10 @@ bool Building::add_elevation_point(Point2 &p, double z, float radius, LAS14Class
       int zcm = int(z * 100);
       //-- 1. Save the ground points seperate for base height
       if (lasclass == LAS_GROUND || lasclass == LAS_WATER) {
-        _zvaluesground.push_back(zcm);
+        _zvaluesground.add(zcm);
       }
       //-- 2. assign to polygon since within
-      _zvaluesinside.push_back(zcm);
+      _zvaluesinside.add(zcm);
     }
   }
   return true;
@@ -88,8 +86,8 @@ bool Building::is_hard() {
 }
 
 std::string Building::get_csv() {
-  std::stringstream ss;
-  ss << this->get_id() << ";" << std::setprecision(2) << std::fixed << this->get_height() << ";" << this->get_height_base() << std::endl;
+  OutputBuffer ss;
+  ss << this->get_id() << ";" << this->get_height() << ";" << this->get_height_base() << "\n";
   return ss.str();
 }
 
@@ -97,42 +95,35 @@ std::string Building::get_mtl() {
   return "usemtl Building";
 }
 
-std::string Building::get_obj(std::unordered_map< std::string, unsigned long > &dPts, int lod, std::string mtl) {
-  std::stringstream ss;
+void Building::add_obj_vertices(ObjVertexTable &dPts, int lod) {
+  if (lod == 1) {
+    TopoFeature::add_obj_vertices(dPts);
+  }
+  else if (lod == 0) {
+    int z = this->get_height_base();
+    for (auto& t : _triangles) {
+      dPts.get_index(gen_key_bucket(&_vertices[t.v0], z));
+      dPts.get_index(gen_key_bucket(&_vertices[t.v1], z));
+      dPts.get_index(gen_key_bucket(&_vertices[t.v2], z));
+    }
+  }
+}
+
+std::string Building::get_obj(const ObjVertexTable &dPts, int lod, std::string mtl) {
+  OutputBuffer ss;
   if (lod == 1) {
     ss << TopoFeature::get_obj(dPts, mtl);
   }
   else if (lod == 0) {
-    ss << mtl << std::endl;
+    ss << mtl << "\n";
     for (auto& t : _triangles) {
       unsigned long a, b, c;
       int z = this->get_height_base();
-      auto it = dPts.find(gen_key_bucket(&_vertices[t.v0], z));
-      if (it == dPts.end()) {
-        a = dPts.size() + 1;
-        dPts[gen_key_bucket(&_vertices[t.v0], z)] = a;
-      }
-      else {
-        a = it->second;
-      }
-      it = dPts.find(gen_key_bucket(&_vertices[t.v1], z));
-      if (it == dPts.end()) {
-        b = dPts.size() + 1;
-        dPts[gen_key_bucket(&_vertices[t.v1], z)] = b;
-      }
-      else {
-        b = it->second;
-      }
-      it = dPts.find(gen_key_bucket(&_vertices[t.v2], z));
-      if (it == dPts.end()) {
-        c = dPts.size() + 1;
-        dPts[gen_key_bucket(&_vertices[t.v2], z)] = c;
-      }
-      else {
-        c = it->second;
-      }
+      a = dPts.find_index(gen_key_bucket(&_vertices[t.v0], z));
+      b = dPts.find_index(gen_key_bucket(&_vertices[t.v1], z));
+      c = dPts.find_index(gen_key_bucket(&_vertices[t.v2], z));
       if ((a != b) && (a != c) && (b != c))
-        ss << "f " << a << " " << b << " " << c << std::endl;
+        ss << "f " << a << " " << b << " " << c << "\n";
       // else
       //   std::clog << "COLLAPSED TRIANGLE REMOVED" << std::endl;
     }
@@ -140,110 +131,191 @@ std::string Building::get_obj(std::unordered_map< std::string, unsigned long > &
   return ss.str();
 }
 
+void Building::get_mesh(std::vector<Point3> &vertices, std::vector<Triangle> &triangles, int lod) {
+  vertices.clear();
+  triangles.clear();
+  if (lod == 1) {
+    TopoFeature::get_mesh(vertices, triangles);
+  }
+  else if (lod == 0) {
+    //-- the footprint at the height of the base, as for the OBJ
+    float z = z_to_float(this->get_height_base());
+    for (auto& v : _vertices)
+      vertices.push_back(Point3(bg::get<0>(v), bg::get<1>(v), z));
+    triangles = _triangles;
+  }
+}
+
 std::string Building::get_citygml() {
   float h = z_to_float(this->get_height());
   float hbase = z_to_float(this->get_height_base());
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<bldg:Building gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<gen:measureAttribute name=\"min height surface\">" << std::endl;
-  ss << "<gen:value uom=\"#m\">" << hbase << "</gen:value>" << std::endl;
-  ss << "</gen:measureAttribute>" << std::endl;
-  ss << "<bldg:measuredHeight uom=\"#m\">" << h << "</bldg:measuredHeight>" << std::endl;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<bldg:Building gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<gen:measureAttribute name=\"min height surface\">\n";
+  ss << "<gen:value uom=\"#m\">" << hbase << "</gen:value>\n";
+  ss << "</gen:measureAttribute>\n";
+  ss << "<bldg:measuredHeight uom=\"#m\">" << h << "</bldg:measuredHeight>\n";
   //-- LOD0 footprint
-  ss << "<bldg:lod0FootPrint>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << get_polygon_lifted_gml(this->_p2, hbase, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</bldg:lod0FootPrint>" << std::endl;
+  ss << "<bldg:lod0FootPrint>\n";
+  ss << "<gml:MultiSurface>\n";
+  get_polygon_lifted_gml(ss, this->_p2, hbase, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</bldg:lod0FootPrint>\n";
   //-- LOD0 roofedge
-  ss << "<bldg:lod0RoofEdge>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << get_polygon_lifted_gml(this->_p2, h, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</bldg:lod0RoofEdge>" << std::endl;
+  ss << "<bldg:lod0RoofEdge>\n";
+  ss << "<gml:MultiSurface>\n";
+  get_polygon_lifted_gml(ss, this->_p2, h, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</bldg:lod0RoofEdge>\n";
   //-- LOD1 Solid
-  ss << "<bldg:lod1Solid>" << std::endl;
-  ss << "<gml:Solid>" << std::endl;
-  ss << "<gml:exterior>" << std::endl;
-  ss << "<gml:CompositeSurface>" << std::endl;
+  ss << "<bldg:lod1Solid>\n";
+  ss << "<gml:Solid>\n";
+  ss << "<gml:exterior>\n";
+  ss << "<gml:CompositeSurface>\n";
   //-- get floor
-  ss << get_polygon_lifted_gml(this->_p2, hbase, false);
+  get_polygon_lifted_gml(ss, this->_p2, hbase, false);
   //-- get roof
-  ss << get_polygon_lifted_gml(this->_p2, h, true);
+  get_polygon_lifted_gml(ss, this->_p2, h, true);
   //-- get the walls
   auto r = bg::exterior_ring(*(this->_p2));
   int i;
   for (i = 0; i < (r.size() - 1); i++)
-    ss << get_extruded_line_gml(&r[i], &r[i + 1], h, hbase, false);
-  ss << get_extruded_line_gml(&r[i], &r[0], h, hbase, false);
+    get_extruded_line_gml(ss, &r[i], &r[i + 1], h, hbase, false);
+  get_extruded_line_gml(ss, &r[i], &r[0], h, hbase, false);
   //-- irings
   auto irings = bg::interior_rings(*(this->_p2));
   for (Ring2& r : irings) {
     for (i = 0; i < (r.size() - 1); i++)
-      ss << get_extruded_line_gml(&r[i], &r[i + 1], h, hbase, false);
-    ss << get_extruded_line_gml(&r[i], &r[0], h, hbase, false);
+      get_extruded_line_gml(ss, &r[i], &r[i + 1], h, hbase, false);
+    get_extruded_line_gml(ss, &r[i], &r[0], h, hbase, false);
+  }
+  ss << "</gml:CompositeSurface>\n";
+  ss << "</gml:exterior>\n";
+  ss << "</gml:Solid>\n";
+  ss << "</bldg:lod1Solid>\n";
+  ss << "</bldg:Building>\n";
+  ss << "</cityObjectMember>\n";
+  return ss.str();
+}
+
+//-- the indices in dPts of the vertices of the ring lifted to z, reversed for a surface seen from above
+static void get_ring_cityjson(OutputBuffer& ss, ObjVertexTable &dPts, Ring2& r, int z, bool reverse) {
+  ss << "[";
+  for (std::size_t i = 0; i < r.size(); i++) {
+    std::size_t j = (reverse == true) ? (r.size() - 1 - i) : i;
+    if (i > 0)
+      ss << ",";
+    ss << (dPts.get_index(gen_key_bucket(&r[j], z)) - 1);
+  }
+  ss << "]";
+}
+
+static void get_polygon_cityjson(OutputBuffer& ss, ObjVertexTable &dPts, Polygon2* p2, int z, bool reverse) {
+  ss << "[";
+  get_ring_cityjson(ss, dPts, bg::exterior_ring(*p2), z, reverse);
+  for (Ring2& r : bg::interior_rings(*p2)) {
+    ss << ",";
+    get_ring_cityjson(ss, dPts, r, z, reverse);
+  }
+  ss << "]";
+}
+
+std::string Building::get_cityjson(ObjVertexTable &dPts) {
+  int h = this->get_height();
+  int hbase = this->get_height_base();
+  OutputBuffer ss;
+  ss << get_json_string(this->get_id()) << ": {\"type\": \"Building\", ";
+  //-- gml_id is not an attribute, the string can be empty with _attributes not empty
+  std::string attributes = get_cityjson_attributes(_attributes);
+  ss << "\"attributes\": {" << attributes;
+  if (attributes.empty() == false)
+    ss << ", ";
+  ss << "\"measuredHeight\": " << z_to_float(h) << ", \"min height surface\": " << z_to_float(hbase) << "}, ";
+  ss << "\"geometry\": [";
+  //-- LOD0 footprint
+  ss << "{\"type\": \"MultiSurface\", \"lod\": 0, \"boundaries\": [";
+  get_polygon_cityjson(ss, dPts, this->_p2, hbase, false);
+  ss << "]}, ";
+  //-- LOD1 Solid: the rings are cw, so the floor is kept and the roof reversed for outward normals
+  OutputBuffer values;
+  ss << "{\"type\": \"Solid\", \"lod\": 1, \"boundaries\": [[";
+  get_polygon_cityjson(ss, dPts, this->_p2, hbase, false);
+  ss << ",";
+  get_polygon_cityjson(ss, dPts, this->_p2, h, true);
+  values << "1,0";
+  //-- the walls, the interior of the polygon is on the right of every ring
+  std::vector<Ring2*> rings;
+  rings.push_back(&bg::exterior_ring(*(this->_p2)));
+  for (Ring2& r : bg::interior_rings(*(this->_p2)))
+    rings.push_back(&r);
+  for (Ring2* r : rings) {
+    for (std::size_t i = 0; i < r->size(); i++) {
+      Point2& a = (*r)[i];
+      Point2& b = (*r)[(i + 1) % r->size()];
+      ss << ",[[" << (dPts.get_index(gen_key_bucket(&a, hbase)) - 1) << ",";
+      ss << (dPts.get_index(gen_key_bucket(&a, h)) - 1) << ",";
+      ss << (dPts.get_index(gen_key_bucket(&b, h)) - 1) << ",";
+      ss << (dPts.get_index(gen_key_bucket(&b, hbase)) - 1) << "]]";
+      values << ",2";
+    }
   }
-  ss << "</gml:CompositeSurface>" << std::endl;
-  ss << "</gml:exterior>" << std::endl;
-  ss << "</gml:Solid>" << std::endl;
-  ss << "</bldg:lod1Solid>" << std::endl;
-  ss << "</bldg:Building>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "]], \"semantics\": {\"surfaces\": [{\"type\": \"RoofSurface\"}, {\"type\": \"GroundSurface\"}, {\"type\": \"WallSurface\"}], ";
+  ss << "\"values\": [[" << values.str() << "]]}}";
+  ss << "]}";
   return ss.str();
 }
 
 std::string Building::get_citygml_imgeo() {
   float h = z_to_float(this->get_height());
   float hbase = z_to_float(this->get_height_base());
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<bui:Building gml:id=\"" << this->get_id() << "\">" << std::endl;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<bui:Building gml:id=\"" << this->get_id() << "\">\n";
   //-- store building information
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<bui:consistsOfBuildingPart>" << std::endl;
-  ss << "<bui:BuildingPart>" << std::endl;
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<bui:consistsOfBuildingPart>\n";
+  ss << "<bui:BuildingPart>\n";
   //-- LOD1 Solid
-  ss << "<bui:lod1Solid>" << std::endl;
-  ss << "<gml:Solid>" << std::endl;
-  ss << "<gml:exterior>" << std::endl;
-  ss << "<gml:CompositeSurface>" << std::endl;
+  ss << "<bui:lod1Solid>\n";
+  ss << "<gml:Solid>\n";
+  ss << "<gml:exterior>\n";
+  ss << "<gml:CompositeSurface>\n";
   //-- get floor
-  ss << get_polygon_lifted_gml(this->_p2, hbase, false);
+  get_polygon_lifted_gml(ss, this->_p2, hbase, false);
   //-- get roof
-  ss << get_polygon_lifted_gml(this->_p2, h, true);
+  get_polygon_lifted_gml(ss, this->_p2, h, true);
   //-- get the walls
   auto r = bg::exterior_ring(*(this->_p2));
   int i;
   for (i = 0; i < (r.size() - 1); i++)
-    ss << get_extruded_line_gml(&r[i], &r[i + 1], h, hbase, false);
-  ss << get_extruded_line_gml(&r[i], &r[0], h, hbase, false);
+    get_extruded_line_gml(ss, &r[i], &r[i + 1], h, hbase, false);
+  get_extruded_line_gml(ss, &r[i], &r[0], h, hbase, false);
   //-- irings
   auto irings = bg::interior_rings(*(this->_p2));
   for (Ring2& r : irings) {
     for (i = 0; i < (r.size() - 1); i++)
-      ss << get_extruded_line_gml(&r[i], &r[i + 1], h, hbase, false);
-    ss << get_extruded_line_gml(&r[i], &r[0], h, hbase, false);
+      get_extruded_line_gml(ss, &r[i], &r[i + 1], h, hbase, false);
+    get_extruded_line_gml(ss, &r[i], &r[0], h, hbase, false);
   }
-  ss << "</gml:CompositeSurface>" << std::endl;
-  ss << "</gml:exterior>" << std::endl;
-  ss << "</gml:Solid>" << std::endl;
-  ss << "</bui:lod1Solid>" << std::endl;
+  ss << "</gml:CompositeSurface>\n";
+  ss << "</gml:exterior>\n";
+  ss << "</gml:Solid>\n";
+  ss << "</bui:lod1Solid>\n";
   std::string attribute;
   if (get_attribute("identificatiebagpnd", attribute)) {
-    ss << "<imgeo:identificatieBAGPND>" << attribute << "</imgeo:identificatieBAGPND>" << std::endl;
+    ss << "<imgeo:identificatieBAGPND>" << attribute << "</imgeo:identificatieBAGPND>\n";
   }
-  ss << get_imgeo_nummeraanduiding();
-  ss << "</bui:BuildingPart>" << std::endl;
-  ss << "</bui:consistsOfBuildingPart>" << std::endl;
-  ss << "</bui:Building>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+  get_imgeo_nummeraanduiding(ss);
+  ss << "</bui:BuildingPart>\n";
+  ss << "</bui:consistsOfBuildingPart>\n";
+  ss << "</bui:Building>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
-std::string Building::get_imgeo_nummeraanduiding() {
-  std::stringstream ss;
+void Building::get_imgeo_nummeraanduiding(OutputBuffer& ss) {
   std::string attribute;
   bool btekst, bplaatsingspunt, bhoek, blaagnr, bhoognr;
   std::string tekst, plaatsingspunt, hoek, laagnr, hoognr;
@@ -274,31 +346,30 @@ std::string Building::get_imgeo_nummeraanduiding() {
     int count = boost::lexical_cast<int>(tekst[1]);
     for (int i = 0; i < count; i++) {
       if (i < tekst_split.size() && i < plaatsingspunt_split.size() && i < hoek_split.size()) {
-        ss << "<imgeo:nummeraanduidingreeks>" << std::endl;
-        ss << "<imgeo:Nummeraanduidingreeks>" << std::endl;
-        ss << "<imgeo:nummeraanduidingreeks>" << std::endl;
-        ss << "<imgeo:Label>" << std::endl;
-        ss << "<imgeo:tekst>" << tekst_split.at(i) << "</imgeo:tekst>" << std::endl;
-        ss << "<imgeo:positie>" << std::endl;
-        ss << "<imgeo:Labelpositie>" << std::endl;
-        ss << "<imgeo:plaatsingspunt><gml:Point srsDimension=\"2\"><gml:pos>" << plaatsingspunt_split.at(i) << "</gml:pos></gml:Point></imgeo:plaatsingspunt>" << std::endl;
-        ss << "<imgeo:hoek>" << hoek_split.at(i) << "</imgeo:hoek>" << std::endl;
-        ss << "</imgeo:Labelpositie>" << std::endl;
-        ss << "</imgeo:positie>" << std::endl;
-        ss << "</imgeo:Label>" << std::endl;
-        ss << "</imgeo:nummeraanduidingreeks>" << std::endl;
+        ss << "<imgeo:nummeraanduidingreeks>\n";
+        ss << "<imgeo:Nummeraanduidingreeks>\n";
+        ss << "<imgeo:nummeraanduidingreeks>\n";
+        ss << "<imgeo:Label>\n";
+        ss << "<imgeo:tekst>" << tekst_split.at(i) << "</imgeo:tekst>\n";
+        ss << "<imgeo:positie>\n";
+        ss << "<imgeo:Labelpositie>\n";
+        ss << "<imgeo:plaatsingspunt><gml:Point srsDimension=\"2\"><gml:pos>" << plaatsingspunt_split.at(i) << "</gml:pos></gml:Point></imgeo:plaatsingspunt>\n";
+        ss << "<imgeo:hoek>" << hoek_split.at(i) << "</imgeo:hoek>\n";
+        ss << "</imgeo:Labelpositie>\n";
+        ss << "</imgeo:positie>\n";
+        ss << "</imgeo:Label>\n";
+        ss << "</imgeo:nummeraanduidingreeks>\n";
         if (i < laagnr_split.size()) {
-          ss << "<imgeo:identificatieBAGVBOLaagsteHuisnummer>" << laagnr_split.at(i) << "</imgeo:identificatieBAGVBOLaagsteHuisnummer>" << std::endl;
+          ss << "<imgeo:identificatieBAGVBOLaagsteHuisnummer>" << laagnr_split.at(i) << "</imgeo:identificatieBAGVBOLaagsteHuisnummer>\n";
         }
         if (i < hoognr_split.size()) {
-          ss << "<imgeo:identificatieBAGVBOHoogsteHuisnummer>" << hoognr_split.at(i) << "</imgeo:identificatieBAGVBOHoogsteHuisnummer>" << std::endl;
+          ss << "<imgeo:identificatieBAGVBOHoogsteHuisnummer>" << hoognr_split.at(i) << "</imgeo:identificatieBAGVBOHoogsteHuisnummer>\n";
         }
-        ss << "</imgeo:Nummeraanduidingreeks>" << std::endl;
-        ss << "</imgeo:nummeraanduidingreeks>" << std::endl;
+        ss << "</imgeo:Nummeraanduidingreeks>\n";
+        ss << "</imgeo:nummeraanduidingreeks>\n";
       }
     }
   }
-  return ss.str();
 }
 
 bool Building::get_shape(OGRLayer* layer) {
@@ -36,10 +36,13 @@ public:
   Building(char *wkt, std::string layername, std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes, std::string pid, float heightref_top, float heightref_base);
   bool          lift();
   bool          add_elevation_point(Point2 &p, double z, float radius, LAS14Class lasclass, bool lastreturn);
-  std::string   get_obj(std::unordered_map< std::string, unsigned long > &dPts, int lod, std::string mtl);
+  void          add_obj_vertices(ObjVertexTable &dPts, int lod);
+  std::string   get_obj(const ObjVertexTable &dPts, int lod, std::string mtl);
+  void          get_mesh(std::vector<Point3> &vertices, std::vector<Triangle> &triangles, int lod);
   std::string   get_citygml();
   std::string   get_citygml_imgeo();
-  std::string   get_imgeo_nummeraanduiding();
+  std::string   get_cityjson(ObjVertexTable &dPts);
+  void          get_imgeo_nummeraanduiding(OutputBuffer& ss);
   std::string   get_csv();
   std::string   get_mtl();
   bool          get_shape(OGRLayer * layer);
@@ -47,7 +50,7 @@ public:
   bool          is_hard();
   int           get_height_base();
 private:
-  std::vector<int>    _zvaluesground;
+  ZAccumulator        _zvaluesground;
   static float        _heightref_top;
   static float        _heightref_base;
   int                 _height_base;
@@ -0,0 +1,140 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef CoordMap_h
+#define CoordMap_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+//-- coordinates quantised to integer mm, used as key instead of a string (see gen_key_bucket())
+typedef struct CoordKey {
+  int64_t x;
+  int64_t y;
+  int64_t z;
+  bool operator==(const CoordKey& other) const {
+    return (x == other.x && y == other.y && z == other.z);
+  }
+} CoordKey;
+
+//-- hash map with open addressing (linear probing) for CoordKey.
+//-- the capacity is a power of 2 and is doubled when the map is half full.
+template <typename V>
+class CoordMap {
+public:
+  CoordMap() : _size(0) {}
+
+  V* find(const CoordKey& key) {
+    if (_size == 0)
+      return NULL;
+    std::size_t mask = _keys.size() - 1;
+    for (std::size_t i = hash(key) & mask; _used[i]; i = (i + 1) & mask) {
+      if (_keys[i] == key)
+        return &_values[i];
+    }
+    return NULL;
+  }
+
+  const V* find(const CoordKey& key) const {
+    return const_cast<CoordMap<V>*>(this)->find(key);
+  }
+
+  V& operator[](const CoordKey& key) {
+    if ((_size + 1) * 2 > _keys.size())
+      grow();
+    std::size_t mask = _keys.size() - 1;
+    std::size_t i = hash(key) & mask;
+    for (; _used[i]; i = (i + 1) & mask) {
+      if (_keys[i] == key)
+        return _values[i];
+    }
+    _used[i] = 1;
+    _keys[i] = key;
+    _size++;
+    return _values[i];
+  }
+
+  std::size_t size() const {
+    return _size;
+  }
+
+  void clear() {
+    std::vector<CoordKey>().swap(_keys);
+    std::vector<V>().swap(_values);
+    std::vector<char>().swap(_used);
+    _size = 0;
+  }
+
+  //-- calls f(key, value) for each entry, in no particular order
+  template <typename F>
+  void for_each(F f) {
+    for (std::size_t i = 0; i < _keys.size(); i++) {
+      if (_used[i])
+        f(_keys[i], _values[i]);
+    }
+  }
+
+private:
+  std::vector<CoordKey> _keys;
+  std::vector<V>        _values;
+  std::vector<char>     _used;
+  std::size_t           _size;
+
+  static std::size_t hash(const CoordKey& key) {
+    uint64_t h = uint64_t(key.x) * 0x9E3779B97F4A7C15ULL;
+    h ^= uint64_t(key.y) + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    h ^= uint64_t(key.z) + 0x85EBCA77C2B2AE63ULL + (h << 6) + (h >> 2);
+    h ^= (h >> 31);
+    return std::size_t(h);
+  }
+
+  void grow() {
+    std::size_t capacity = _keys.empty() ? 16 : _keys.size() * 2;
+    std::vector<CoordKey> keys(capacity);
+    std::vector<V> values(capacity);
+    std::vector<char> used(capacity, 0);
+    std::size_t mask = capacity - 1;
+    for (std::size_t j = 0; j < _keys.size(); j++) {
+      if (_used[j] == 0)
+        continue;
+      std::size_t i = hash(_keys[j]) & mask;
+      while (used[i])
+        i = (i + 1) & mask;
+      used[i] = 1;
+      keys[i] = _keys[j];
+      values[i] = std::move(_values[j]);
+    }
+    _keys.swap(keys);
+    _values.swap(values);
+    _used.swap(used);
+  }
+};
+
+#endif /* CoordMap_h */
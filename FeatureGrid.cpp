@@ -0,0 +1,143 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "FeatureGrid.h"
+
+#define GRID_MAX_CELLS 67108864 //-- upper bound on the # of cells of the grid
+
+FeatureGrid::FeatureGrid() {
+  _minx = 0.0;
+  _miny = 0.0;
+  _cellsize = 1.0;
+  _ncols = 0;
+  _nrows = 0;
+}
+
+bool FeatureGrid::build(const std::vector<TopoFeature*> &features, Box2 bbox, float radius, float building_radius) {
+  this->clear();
+  if (features.empty())
+    return false;
+  float maxradius = std::max(radius, building_radius);
+  _minx = bg::get<bg::min_corner, 0>(bbox) - maxradius;
+  _miny = bg::get<bg::min_corner, 1>(bbox) - maxradius;
+  double width = bg::get<bg::max_corner, 0>(bbox) + maxradius - _minx;
+  double height = bg::get<bg::max_corner, 1>(bbox) + maxradius - _miny;
+
+  //-- cell size is the average size of the buffered bbox of the features,
+  //-- so that a feature covers a few cells and a cell has a few features
+  double sum = 0.0;
+  for (auto& f : features) {
+    Box2 b = f->get_bbox2d();
+    float r = (f->get_class() == BUILDING) ? building_radius : radius;
+    sum += std::max(bg::get<bg::max_corner, 0>(b) - bg::get<bg::min_corner, 0>(b),
+                    bg::get<bg::max_corner, 1>(b) - bg::get<bg::min_corner, 1>(b)) + (2 * r);
+  }
+  _cellsize = std::max(sum / features.size(), 0.1);
+  while ((std::ceil(width / _cellsize) * std::ceil(height / _cellsize)) > GRID_MAX_CELLS)
+    _cellsize *= 2;
+  _ncols = std::max(std::size_t(1), std::size_t(std::ceil(width / _cellsize)));
+  _nrows = std::max(std::size_t(1), std::size_t(std::ceil(height / _cellsize)));
+
+  //-- first pass counts the features per cell, second pass fills the lists
+  _offsets.assign((_ncols * _nrows) + 1, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    std::vector<std::size_t> fill;
+    if (pass == 1) {
+      for (std::size_t i = 1; i < _offsets.size(); i++)
+        _offsets[i] += _offsets[i - 1];
+      _cells.resize(_offsets.back());
+      fill.assign(_offsets.begin(), _offsets.end() - 1);
+    }
+    for (auto& f : features) {
+      Box2 b = f->get_bbox2d();
+      float r = (f->get_class() == BUILDING) ? building_radius : radius;
+      std::size_t col0, row0, col1, row1;
+      this->get_cell(bg::get<bg::min_corner, 0>(b) - r, bg::get<bg::min_corner, 1>(b) - r, col0, row0);
+      this->get_cell(bg::get<bg::max_corner, 0>(b) + r, bg::get<bg::max_corner, 1>(b) + r, col1, row1);
+      for (std::size_t row = row0; row <= row1; row++) {
+        for (std::size_t col = col0; col <= col1; col++) {
+          std::size_t cell = (row * _ncols) + col;
+          if (pass == 0)
+            _offsets[cell + 1]++;
+          else
+            _cells[fill[cell]++] = f;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void FeatureGrid::clear() {
+  _ncols = 0;
+  _nrows = 0;
+  std::vector<std::size_t>().swap(_offsets);
+  std::vector<TopoFeature*>().swap(_cells);
+}
+
+bool FeatureGrid::is_built() const {
+  return !_offsets.empty();
+}
+
+//-- returns false if (x, y) is outside the grid; col/row are then clamped to it
+bool FeatureGrid::get_cell(double x, double y, std::size_t &col, std::size_t &row) const {
+  bool inside = true;
+  double c = std::floor((x - _minx) / _cellsize);
+  double r = std::floor((y - _miny) / _cellsize);
+  if (c < 0 || c >= _ncols || r < 0 || r >= _nrows)
+    inside = false;
+  col = std::size_t(std::min(std::max(c, 0.0), double(_ncols - 1)));
+  row = std::size_t(std::min(std::max(r, 0.0), double(_nrows - 1)));
+  return inside;
+}
+
+void FeatureGrid::get_features(std::size_t col, std::size_t row, std::vector<TopoFeature*>::const_iterator &begin, std::vector<TopoFeature*>::const_iterator &end) const {
+  std::size_t cell = (row * _ncols) + col;
+  begin = _cells.begin() + _offsets[cell];
+  end = _cells.begin() + _offsets[cell + 1];
+}
+
+double FeatureGrid::get_minx() const {
+  return _minx;
+}
+
+double FeatureGrid::get_miny() const {
+  return _miny;
+}
+
+double FeatureGrid::get_cell_size() const {
+  return _cellsize;
+}
+
+std::size_t FeatureGrid::get_num_cells() const {
+  return _ncols * _nrows;
+}
+
+std::size_t FeatureGrid::get_memory_usage() const {
+  return (_offsets.capacity() * sizeof(std::size_t)) + (_cells.capacity() * sizeof(TopoFeature*));
+}
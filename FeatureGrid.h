@@ -0,0 +1,61 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef FeatureGrid_h
+#define FeatureGrid_h
+
+#include "TopoFeature.h"
+
+//-- static uniform grid over the features, used to route the LiDAR points.
+//-- each cell lists the features whose bbox buffered by their radius overlaps it,
+//-- the lists are stored contiguously (one offset per cell) to keep it compact.
+class FeatureGrid {
+public:
+  FeatureGrid();
+
+  bool   build(const std::vector<TopoFeature*> &features, Box2 bbox, float radius, float building_radius);
+  void   clear();
+  bool   is_built() const;
+  bool   get_cell(double x, double y, std::size_t &col, std::size_t &row) const;
+  void   get_features(std::size_t col, std::size_t row, std::vector<TopoFeature*>::const_iterator &begin, std::vector<TopoFeature*>::const_iterator &end) const;
+  double get_minx() const;
+  double get_miny() const;
+  double get_cell_size() const;
+  std::size_t get_num_cells() const;
+  std::size_t get_memory_usage() const;
+private:
+  double                    _minx;
+  double                    _miny;
+  double                    _cellsize;
+  std::size_t               _ncols;
+  std::size_t               _nrows;
+  std::vector<std::size_t>  _offsets;
+  std::vector<TopoFeature*> _cells;
+};
+
+#endif /* FeatureGrid_h */
@@ -64,50 +64,52 @@ bool Forest::lift() {
 }
 
 std::string Forest::get_citygml() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<veg:PlantCover gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<veg:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<veg:PlantCover gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<veg:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</veg:lod1MultiSurface>" << std::endl;
-  ss << "</veg:PlantCover>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</veg:lod1MultiSurface>\n";
+  ss << "</veg:PlantCover>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
+std::string Forest::get_cityjson(ObjVertexTable &dPts) {
+  return get_cityjson_object("PlantCover", get_cityjson_multisurface(dPts));
+}
+
 std::string Forest::get_citygml_imgeo() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<veg:PlantCover gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<veg:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<veg:PlantCover gml:id=\"" << this->get_id() << "\">\n";
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<veg:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</veg:lod1MultiSurface>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</veg:lod1MultiSurface>\n";
   std::string attribute;
   if (get_attribute("bgt-fysiekvoorkomen", attribute)) {
-    ss << "<veg:class codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenBegroeidTerrein\">" << attribute << "</veg:class>" << std::endl;
+    ss << "<veg:class codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenBegroeidTerrein\">" << attribute << "</veg:class>\n";
   }
   if (get_attribute("begroeidterreindeeloptalud", attribute, "false")) {
-    ss << "<imgeo:begroeidTerreindeelOpTalud>" << attribute << "</imgeo:begroeidTerreindeelOpTalud>" << std::endl;
+    ss << "<imgeo:begroeidTerreindeelOpTalud>" << attribute << "</imgeo:begroeidTerreindeelOpTalud>\n";
   }
   if (get_attribute("plus-fysiekvoorkomen", attribute)) {
-    ss << "<imgeo:plus-fysiekVoorkomen codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenBegroeidTerreinPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomen>" << std::endl;
+    ss << "<imgeo:plus-fysiekVoorkomen codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenBegroeidTerreinPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomen>\n";
   }
-  ss << "</veg:PlantCover>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "</veg:PlantCover>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
@@ -29,6 +29,18 @@
 #include "Map3d.h"
 #include "io.h"
 #include "boost/locale.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include <memory>
+#include <chrono>
+
+//-- time spent in a stage of the processing
+static void log_stage_duration(std::string stage, std::chrono::steady_clock::time_point starttime) {
+  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - starttime;
+  std::clog << stage << ": " << duration.count() << " s" << std::endl;
+}
 
 Map3d::Map3d() {
   OGRRegisterAll();
@@ -46,6 +58,17 @@ Map3d::Map3d() {
   _radius_vertex_elevation = 1.0;
   _building_radius_vertex_elevation = 3.0;
   _threshold_jump_edges = 50;
+  _threads = get_default_number_threads();
+  _max_concurrent_files = 4;
+  _use_feature_grid = false;
+  _use_las_index = true;
+  _use_shared_nodes = true;
+  _parallel_stitching = false;
+  _tiled = false;
+  _tilefirst = true;
+  _tilelast = true;
+  for (int c = 0; c < 256; c++)
+    _pointdemand[c] = DEMAND_ANY_RETURN | DEMAND_LAST_RETURN;
   bg::set<bg::min_corner, 0>(_bbox, 999999);
   bg::set<bg::min_corner, 1>(_bbox, 999999);
   bg::set<bg::max_corner, 0>(_bbox, -999999);
@@ -133,6 +156,45 @@ void Map3d::set_requested_extent(double xmin, double ymin, double xmax, double y
   _requestedExtent = Box2(Point2(xmin, ymin), Point2(xmax, ymax));
 }
 
+void Map3d::set_max_concurrent_files(int files) {
+  _max_concurrent_files = std::max(1, files);
+}
+
+void Map3d::set_use_feature_grid(bool usegrid) {
+  _use_feature_grid = usegrid;
+}
+
+void Map3d::set_use_las_index(bool useindex) {
+  _use_las_index = useindex;
+}
+
+void Map3d::set_las_index_dir(std::string dir) {
+  _las_index_dir = dir;
+}
+
+void Map3d::set_point_cache(std::string dir) {
+  _point_cache = dir;
+}
+
+void Map3d::set_elevation_accumulator(bool histogram, int bins) {
+  ZAccumulator::set_histogram(histogram, bins);
+}
+
+void Map3d::set_use_shared_nodes(bool usenodes) {
+  _use_shared_nodes = usenodes;
+}
+
+void Map3d::set_parallel_stitching(bool parallel) {
+  _parallel_stitching = parallel;
+}
+
+void Map3d::set_threads(int threads) {
+  if (threads > 0)
+    _threads = threads;
+  else
+    _threads = get_default_number_threads();
+}
+
 Box2 Map3d::get_bbox() {
   return _bbox;
 }
@@ -144,120 +206,840 @@ liblas::Bounds<double> Map3d::get_bounds() {
 }
 
 void Map3d::get_citygml(std::ofstream &outputfile) {
-  std::stringstream ss;
-  ss << std::setprecision(3) << std::fixed;
-  ss << get_xml_header() << std::endl;
-  ss << get_citygml_namespaces() << std::endl;
-  ss << "<!-- Automatically generated by 3dfier (https://github.com/tudelft3d/3dfier), a software made with <3 by the 3D geoinformation group, TU Delft -->" << std::endl;
-  ss << "<gml:name>my 3dfied map</gml:name>" << std::endl;
-  ss << "<gml:boundedBy>" << std::endl;
-  ss << "<gml:Envelope srsDimension=\"3\" srsName=\"urn:ogc:def:crs:EPSG::7415\">" << std::endl;
+  Box2 bbox = (_tiled == true) ? _tileextent : _bbox;
+  OutputBuffer ss;
+  ss << get_xml_header() << "\n";
+  ss << get_citygml_namespaces() << "\n";
+  ss << "<!-- Automatically generated by 3dfier (https://github.com/tudelft3d/3dfier), a software made with <3 by the 3D geoinformation group, TU Delft -->" << "\n";
+  ss << "<gml:name>my 3dfied map</gml:name>" << "\n";
+  ss << "<gml:boundedBy>" << "\n";
+  ss << "<gml:Envelope srsDimension=\"3\" srsName=\"urn:ogc:def:crs:EPSG::7415\">" << "\n";
   ss << "<gml:lowerCorner>";
-  ss << bg::get<bg::min_corner, 0>(_bbox) << " " << bg::get<bg::min_corner, 1>(_bbox) << " 0";
-  ss << "</gml:lowerCorner>" << std::endl;
+  ss << bg::get<bg::min_corner, 0>(bbox) << " " << bg::get<bg::min_corner, 1>(bbox) << " 0";
+  ss << "</gml:lowerCorner>" << "\n";
   ss << "<gml:upperCorner>";
-  ss << bg::get<bg::max_corner, 0>(_bbox) << " " << bg::get<bg::max_corner, 1>(_bbox) << " 100";
-  ss << "</gml:upperCorner>" << std::endl;
-  ss << "</gml:Envelope>" << std::endl;
-  ss << "</gml:boundedBy>" << std::endl;
-  outputfile << ss.str();
-  for (auto& f : _lsFeatures) {
-    outputfile << f->get_citygml();
-  }
-  outputfile << "</CityModel>" << std::endl;
+  ss << bg::get<bg::max_corner, 0>(bbox) << " " << bg::get<bg::max_corner, 1>(bbox) << " 100";
+  ss << "</gml:upperCorner>" << "\n";
+  ss << "</gml:Envelope>" << "\n";
+  ss << "</gml:boundedBy>" << "\n";
+  if (_tilefirst == true)
+    ss.write(outputfile);
+  this->write_features(outputfile, [](TopoFeature* f, std::string& s) {
+    s += f->get_citygml();
+  });
+  if (_tilelast == true)
+    outputfile << "</CityModel>" << std::endl;
 }
 
 void Map3d::get_citygml_imgeo(std::ofstream &outputfile) {
-  std::stringstream ss;
-  ss << std::setprecision(3) << std::fixed;
-  ss << get_xml_header() << std::endl;
-  ss << get_citygml_imgeo_namespaces() << std::endl;
-  ss << "<gml:name>my 3dfied map</gml:name>" << std::endl;
-  ss << "<gml:boundedBy>" << std::endl;
-  ss << "<gml:Envelope srsDimension=\"3\" srsName=\"urn:ogc:def:crs:EPSG::7415\">" << std::endl;
+  Box2 bbox = (_tiled == true) ? _tileextent : _bbox;
+  OutputBuffer ss;
+  ss << get_xml_header() << "\n";
+  ss << get_citygml_imgeo_namespaces() << "\n";
+  ss << "<gml:name>my 3dfied map</gml:name>" << "\n";
+  ss << "<gml:boundedBy>" << "\n";
+  ss << "<gml:Envelope srsDimension=\"3\" srsName=\"urn:ogc:def:crs:EPSG::7415\">" << "\n";
   ss << "<gml:lowerCorner>";
-  ss << bg::get<bg::min_corner, 0>(_bbox) << " " << bg::get<bg::min_corner, 1>(_bbox) << " 0";
-  ss << "</gml:lowerCorner>" << std::endl;
+  ss << bg::get<bg::min_corner, 0>(bbox) << " " << bg::get<bg::min_corner, 1>(bbox) << " 0";
+  ss << "</gml:lowerCorner>" << "\n";
   ss << "<gml:upperCorner>";
-  ss << bg::get<bg::max_corner, 0>(_bbox) << " " << bg::get<bg::max_corner, 1>(_bbox) << " 100";
-  ss << "</gml:upperCorner>" << std::endl;
-  ss << "</gml:Envelope>" << std::endl;
-  ss << "</gml:boundedBy>" << std::endl;
-  outputfile << ss.str();
-  for (auto& f : _lsFeatures) {
-    outputfile << f->get_citygml_imgeo();
-  }
-  outputfile << "</CityModel>" << std::endl;
+  ss << bg::get<bg::max_corner, 0>(bbox) << " " << bg::get<bg::max_corner, 1>(bbox) << " 100";
+  ss << "</gml:upperCorner>" << "\n";
+  ss << "</gml:Envelope>" << "\n";
+  ss << "</gml:boundedBy>" << "\n";
+  if (_tilefirst == true)
+    ss.write(outputfile);
+  this->write_features(outputfile, [](TopoFeature* f, std::string& s) {
+    s += f->get_citygml_imgeo();
+  });
+  if (_tilelast == true)
+    outputfile << "</CityModel>" << std::endl;
 }
 
 void Map3d::get_csv_buildings(std::ofstream &outputfile) {
-  outputfile << "id;roof;floor" << std::endl;
-  for (auto& p : _lsFeatures) {
+  if (_tilefirst == true)
+    outputfile << "id;roof;floor" << std::endl;
+  this->write_features(outputfile, [](TopoFeature* p, std::string& s) {
     if (p->get_class() == BUILDING) {
       Building* b = dynamic_cast<Building*>(p);
       // if (b != nullptr)
-      outputfile << b->get_csv();
+      s += b->get_csv();
+    }
+  });
+}
+
+//-- in tiled mode a feature belongs to the tile containing the centre of its bbox,
+//-- the tiles on the border of the extent are set to be unbounded outwards
+bool Map3d::is_output_feature(TopoFeature* f) {
+  if (_tiled == false)
+    return true;
+  Box2 bbox = f->get_bbox2d();
+  double cx = (bg::get<bg::min_corner, 0>(bbox) + bg::get<bg::max_corner, 0>(bbox)) / 2;
+  double cy = (bg::get<bg::min_corner, 1>(bbox) + bg::get<bg::max_corner, 1>(bbox)) / 2;
+  return (cx >= bg::get<bg::min_corner, 0>(_tile) && cx < bg::get<bg::max_corner, 0>(_tile) &&
+          cy >= bg::get<bg::min_corner, 1>(_tile) && cy < bg::get<bg::max_corner, 1>(_tile));
+}
+
+void Map3d::set_output_tile(const Box2 &tile, const Box2 &extent, bool first, bool last) {
+  _tiled = true;
+  _tile = tile;
+  _tileextent = extent;
+  _tilefirst = first;
+  _tilelast = last;
+  //-- the neighbours of a feature sticking out of the polygons read for the tile are missing,
+  //-- it is then stitched differently than in the tile of these neighbours
+  if (boost::geometry::area(_requestedExtent) > 0) {
+    unsigned long outside = 0;
+    for (auto& f : _lsFeatures) {
+      if (this->is_output_feature(f) == true && bg::within(f->get_bbox2d(), _requestedExtent) == false)
+        outside++;
+    }
+    if (outside > 0)
+      std::cerr << "WARNING: " << outside << " polygons of the tile extend beyond its buffer, they might not be stitched with all their neighbours (increase tile_buffer)." << std::endl;
+  }
+}
+
+//-- the features written by a tile are stitched with their neighbours written by later tiles,
+//-- which are stitched again in those tiles with other neighbours: at each vertex between
+//-- them, the elevations (and the node column) of the first tile are kept and imposed to the
+//-- later ones by apply_decided_heights(), so that the features of both tiles fit (no cracks).
+//-- The tiles are processed row by row (tilesperrow): the vertices decided by a tile are only
+//-- shared with the next tile and the 3 tiles below it, once those are done they are dropped.
+void Map3d::save_decided_heights(std::size_t tile, std::size_t tilesperrow) {
+  if (_decidedheights.size() > 0 && tile >= tilesperrow + 1) {
+    CoordMap<DecidedHeights> kept;
+    _decidedheights.for_each([&kept, tile, tilesperrow](const CoordKey& key, DecidedHeights& decided) {
+      if (decided.tile + tilesperrow + 1 > tile)
+        kept[key] = std::move(decided);
+    });
+    _decidedheights = std::move(kept);
+  }
+  if (_tiled == false || _vertexindex.is_built() == false)
+    return;
+  std::size_t nsaved = 0;
+  std::vector<VertexIncidence> incidences;
+  for (auto& f : _lsFeatures) {
+    if (this->is_output_feature(f) == false)
+      continue;
+    Polygon2* p2 = f->get_Polygon2();
+    for (int ringi = 0; ringi <= int(p2->inners().size()); ringi++) {
+      Ring2& ring = (ringi == 0) ? p2->outer() : p2->inners()[ringi - 1];
+      for (int pi = 0; pi < int(ring.size()); pi++) {
+        CoordKey key = gen_key_bucket(&ring[pi]);
+        if (_decidedheights.find(key) != NULL)
+          continue;
+        _vertexindex.get_incidences(ring[pi], incidences);
+        bool border = false;
+        for (auto& inc : incidences) {
+          if (this->is_output_feature(inc.f) == false)
+            border = true;
+        }
+        if (border == false)
+          continue;
+        DecidedHeights& decided = _decidedheights[key];
+        decided.tile = tile;
+        for (auto& inc : incidences)
+          decided.z.push_back(std::make_pair(inc.f->get_id(), inc.f->get_vertex_elevation(inc.ringi, inc.pi)));
+        const std::vector<int>* nc = _nc.find(key);
+        if (nc != NULL)
+          decided.nc = *nc;
+        nsaved++;
+      }
     }
   }
+  std::clog << "Vertices on the border with the next tiles: " << boost::locale::as::number << nsaved << std::endl;
 }
 
+//-- the elevations decided by the previous tiles replace the ones of the stitching here
+void Map3d::apply_decided_heights() {
+  if (_decidedheights.size() == 0)
+    return;
+  std::size_t napplied = 0;
+  for (auto& f : _lsFeatures) {
+    std::string id = f->get_id();
+    Polygon2* p2 = f->get_Polygon2();
+    for (int ringi = 0; ringi <= int(p2->inners().size()); ringi++) {
+      Ring2& ring = (ringi == 0) ? p2->outer() : p2->inners()[ringi - 1];
+      for (int pi = 0; pi < int(ring.size()); pi++) {
+        CoordKey key = gen_key_bucket(&ring[pi]);
+        const DecidedHeights* decided = _decidedheights.find(key);
+        if (decided == NULL)
+          continue;
+        for (auto& each : decided->z) {
+          if (each.first == id) {
+            f->set_vertex_elevation(ringi, pi, each.second);
+            napplied++;
+            break;
+          }
+        }
+        if (decided->nc.empty() == false)
+          _nc[key] = decided->nc;
+      }
+    }
+  }
+  std::clog << "Elevations decided by the previous tiles: " << boost::locale::as::number << napplied << std::endl;
+}
+
+//-- removes all the features and what was built for them, the options are kept (for the next tile)
+void Map3d::clear_features() {
+  _vertexindex.clear();
+  _nc.clear();
+  _nodes.clear();
+  _grid.clear();
+  _rtree.clear();
+  for (auto& f : _lsFeatures)
+    delete f;
+  std::vector<TopoFeature*>().swap(_lsFeatures);
+  bg::set<bg::min_corner, 0>(_bbox, 999999);
+  bg::set<bg::min_corner, 1>(_bbox, 999999);
+  bg::set<bg::max_corner, 0>(_bbox, -999999);
+  bg::set<bg::max_corner, 1>(_bbox, -999999);
+}
+
+//-- extent of the layers of the polygon files, without reading the polygons
+bool Map3d::get_polygons_extent(std::vector<PolygonFile> &files, Box2 &extent) {
+#if GDAL_VERSION_MAJOR < 2
+  if (OGRSFDriverRegistrar::GetRegistrar()->GetDriverCount() == 0)
+    OGRRegisterAll();
+#else
+  if (GDALGetDriverCount() == 0)
+    GDALAllRegister();
+#endif
+  bool found = false;
+  for (auto& file : files) {
+#if GDAL_VERSION_MAJOR < 2
+    OGRDataSource *dataSource = OGRSFDriverRegistrar::Open(file.filename.c_str(), false);
+#else
+    GDALDataset *dataSource = (GDALDataset*)GDALOpenEx(file.filename.c_str(), GDAL_OF_READONLY, NULL, NULL, NULL);
+#endif
+    if (dataSource == NULL) {
+      std::cerr << "\tERROR: could not open file: " + file.filename << std::endl;
+      return false;
+    }
+    for (int i = 0; i < dataSource->GetLayerCount(); i++) {
+      OGRLayer *dataLayer = dataSource->GetLayer(i);
+      bool used = false;
+      for (auto& l : file.layers) {
+        if (l.first.empty() || l.first == dataLayer->GetName())
+          used = true;
+      }
+      OGREnvelope env;
+      if (used == false || dataLayer->GetExtent(&env, TRUE) != OGRERR_NONE)
+        continue;
+      Box2 b(Point2(env.MinX, env.MinY), Point2(env.MaxX, env.MaxY));
+      if (found == false)
+        extent = b;
+      else
+        bg::expand(extent, b);
+      found = true;
+    }
+#if GDAL_VERSION_MAJOR < 2
+    OGRDataSource::DestroyDataSource(dataSource);
+#else
+    GDALClose(dataSource);
+#endif
+  }
+  return found;
+}
+
+//-- writes the output of get() for all the features, in their order. The threads each
+//-- format a batch of OUTPUT_BATCH_SIZE features into a string, one thread writes them
+//-- to the file; at most a few rounds of batches are kept in memory.
+void Map3d::write_features(std::ofstream &outputfile, std::function<void(TopoFeature*, std::string&)> get) {
+  this->write_features(outputfile, _lsFeatures, get);
+}
+
+//-- the same for the given features; number() is called for them one after the other (in
+//-- their order) before their round is formatted, its output starts the string of the batch.
+void Map3d::write_features(std::ofstream &outputfile, std::vector<TopoFeature*> &features, std::function<void(TopoFeature*, std::string&)> get, std::function<void(TopoFeature*, std::string&)> number) {
+  std::size_t nbatches = (features.size() + OUTPUT_BATCH_SIZE - 1) / OUTPUT_BATCH_SIZE;
+  std::size_t roundsize = 4 * std::size_t(_threads);
+  BlockingQueue< std::vector<std::string> > rounds(2);
+  std::thread writer([&outputfile, &rounds] {
+    std::vector<std::string> round;
+    while (rounds.pop(round)) {
+      for (auto& batch : round)
+        outputfile << batch;
+    }
+  });
+  for (std::size_t first = 0; first < nbatches; first += roundsize) {
+    std::size_t last = std::min(first + roundsize, nbatches);
+    std::vector<std::string> round(last - first);
+    if (number) {
+      for (std::size_t i = 0; i < round.size(); i++) {
+        std::size_t begin = (first + i) * OUTPUT_BATCH_SIZE;
+        std::size_t end = std::min(begin + OUTPUT_BATCH_SIZE, features.size());
+        for (std::size_t j = begin; j < end; j++)
+          if (this->is_output_feature(features[j]) == true)
+            number(features[j], round[i]);
+      }
+    }
+    parallel_for(round.size(), _threads, [this, &features, &round, &get, first](std::size_t i) {
+      std::size_t begin = (first + i) * OUTPUT_BATCH_SIZE;
+      std::size_t end = std::min(begin + OUTPUT_BATCH_SIZE, features.size());
+      for (std::size_t j = begin; j < end; j++)
+        if (this->is_output_feature(features[j]) == true)
+          get(features[j], round[i]);
+    });
+    rounds.push(std::move(round));
+  }
+  rounds.close();
+  writer.join();
+}
+
+//-- the vertices are numbered serially, in the order of the features, and written before
+//-- the faces of their batch; the faces are then formatted on all the threads
 void Map3d::get_obj_per_feature(std::ofstream &outputfile, int z_exaggeration) {
-  std::unordered_map< std::string, unsigned long > dPts;
-  std::stringstream ssf;
-  for (auto& p : _lsFeatures) {
-    ssf << "o " << p->get_id() << std::endl;
+  ObjVertexTable dPts;
+  outputfile << "mtllib ./3dfier.mtl" << std::endl;
+  this->write_obj(outputfile, _lsFeatures, dPts, true);
+  outputfile << std::endl;
+}
+
+void Map3d::get_obj_per_class(std::ofstream &outputfile, int z_exaggeration) {
+  ObjVertexTable dPts;
+  outputfile << "mtllib ./3dfier.mtl" << std::endl;
+  std::vector<TopoFeature*> features;
+  features.reserve(_lsFeatures.size());
+  for (int c = 0; c < 6; c++) {
+    for (auto& p : _lsFeatures) {
+      if (p->get_class() == c)
+        features.push_back(p);
+    }
+  }
+  this->write_obj(outputfile, features, dPts, false);
+  outputfile << std::endl;
+}
+
+void Map3d::write_obj(std::ofstream &outputfile, std::vector<TopoFeature*> &features, ObjVertexTable &dPts, bool names) {
+  const ObjVertexTable& ids = dPts;
+  this->write_features(outputfile, features, [this, &ids, names](TopoFeature* p, std::string& s) {
+    if (names == true)
+      s += "o " + p->get_id() + "\n";
     if (p->get_class() == BUILDING) {
       Building* b = dynamic_cast<Building*>(p);
-      ssf << b->get_obj(dPts, _building_lod, b->get_mtl());
+      s += b->get_obj(ids, _building_lod, b->get_mtl());
     }
     else {
-      ssf << p->get_obj(dPts, p->get_mtl());
+      s += p->get_obj(ids, p->get_mtl());
     }
+  }, [this, &dPts](TopoFeature* p, std::string& s) {
+    if (p->get_class() == BUILDING)
+      dynamic_cast<Building*>(p)->add_obj_vertices(dPts, _building_lod);
+    else
+      p->add_obj_vertices(dPts);
+    dPts.write_new_vertices(s);
+  });
+}
+
+//-- CityJSON: the vertices are integer mm relative to the min corner of the extent and
+//-- shared by all the features, the vertex list is written after the CityObjects
+void Map3d::get_cityjson(std::ofstream &outputfile) {
+  ObjVertexTable dPts;
+  CoordKey translate = { quantise_mm(bg::get<bg::min_corner, 0>(_bbox)), quantise_mm(bg::get<bg::min_corner, 1>(_bbox)), 0 };
+  OutputBuffer ss;
+  ss << "{" << "\n";
+  ss << "\"type\": \"CityJSON\"," << "\n";
+  ss << "\"version\": \"1.0\"," << "\n";
+  ss << "\"transform\": {\"scale\": [0.001, 0.001, 0.001], \"translate\": [";
+  ss.append_mm(translate.x);
+  ss << ", ";
+  ss.append_mm(translate.y);
+  ss << ", 0.0]}," << "\n";
+  ss << "\"CityObjects\": {" << "\n";
+  ss.write(outputfile);
+  bool first = true;
+  for (auto& f : _lsFeatures) {
+    if (this->is_output_feature(f) == false)
+      continue;
+    if (first == false)
+      outputfile << "," << "\n";
+    outputfile << f->get_cityjson(dPts);
+    first = false;
   }
+  outputfile << "\n" << "}," << "\n";
+  outputfile << "\"vertices\": [" << "\n";
+  dPts.write_new_vertices_json(outputfile, translate);
+  outputfile << "\n" << "]" << "\n";
+  outputfile << "}" << std::endl;
+}
 
-  //-- sort the points in the map: simpler to copy to a vector
-  std::vector<std::string> thepts;
-  thepts.resize(dPts.size());
-  for (auto& p : dPts)
-    thepts[p.second - 1] = p.first;
-  dPts.clear();
+void Map3d::get_feature_mesh(TopoFeature* f, std::vector<Point3> &vertices, std::vector<Triangle> &triangles) {
+  if (f->get_class() == BUILDING)
+    dynamic_cast<Building*>(f)->get_mesh(vertices, triangles, _building_lod);
+  else
+    f->get_mesh(vertices, triangles);
+}
 
-  outputfile << "mtllib ./3dfier.mtl" << std::endl;
-  for (auto& p : thepts) {
-    outputfile << "v " << p << std::endl;
+//-- binary PLY: float32 coordinates relative to the min corner of the extent (in a
+//-- comment of the header), each face with the index of its feature and its class.
+//-- The header needs the numbers of vertices and faces, and all the vertices come before
+//-- the faces: the mesh of each feature is built once (in parallel per batch of features)
+//-- and kept in its binary form until all are built.
+bool Map3d::get_ply(std::ofstream &outputfile) {
+  double ox = bg::get<bg::min_corner, 0>(_bbox);
+  double oy = bg::get<bg::min_corner, 1>(_bbox);
+  std::size_t nbatches = (_lsFeatures.size() + OUTPUT_BATCH_SIZE - 1) / OUTPUT_BATCH_SIZE;
+  std::vector<std::string> vertexbatches(nbatches);
+  std::vector<std::string> facebatches(nbatches);
+  std::vector<uint64_t> nbatchvertices(nbatches, 0);
+  std::vector<uint64_t> nbatchfaces(nbatches, 0);
+  parallel_for(nbatches, _threads, [&](std::size_t b) {
+    std::ostringstream vs, fs;
+    std::vector<Point3> vertices;
+    std::vector<Triangle> triangles;
+    std::size_t begin = b * OUTPUT_BATCH_SIZE;
+    std::size_t end = std::min(begin + OUTPUT_BATCH_SIZE, _lsFeatures.size());
+    for (std::size_t i = begin; i < end; i++) {
+      this->get_feature_mesh(_lsFeatures[i], vertices, triangles);
+      for (auto& v : vertices) {
+        write_binary_float(vs, float(bg::get<0>(v) - ox));
+        write_binary_float(vs, float(bg::get<1>(v) - oy));
+        write_binary_float(vs, float(bg::get<2>(v)));
+      }
+      //-- the indices are relative to the batch here, its offset is added when written
+      for (auto& t : triangles) {
+        write_binary_uint32(fs, uint32_t(nbatchvertices[b] + t.v0));
+        write_binary_uint32(fs, uint32_t(nbatchvertices[b] + t.v1));
+        write_binary_uint32(fs, uint32_t(nbatchvertices[b] + t.v2));
+        write_binary_uint32(fs, uint32_t(i));
+        write_binary_uint8(fs, uint8_t(_lsFeatures[i]->get_class()));
+      }
+      nbatchvertices[b] += vertices.size();
+      nbatchfaces[b] += triangles.size();
+    }
+    vertexbatches[b] = vs.str();
+    facebatches[b] = fs.str();
+  });
+  //-- the indices of the vertices are uint32
+  uint64_t nvertices = 0;
+  uint64_t nfaces = 0;
+  for (std::size_t b = 0; b < nbatches; b++) {
+    nvertices += nbatchvertices[b];
+    nfaces += nbatchfaces[b];
+  }
+  if (nvertices > std::numeric_limits<uint32_t>::max() || nfaces > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << "ERROR: Too many vertices (" << nvertices << ") or faces (" << nfaces << ") for the PLY output, the maximum is " << std::numeric_limits<uint32_t>::max() << "." << std::endl;
+    return false;
+  }
+  OutputBuffer header;
+  header << "ply" << "\n";
+  header << "format binary_little_endian 1.0" << "\n";
+  header << "comment Automatically generated by 3dfier (https://github.com/tudelft3d/3dfier)" << "\n";
+  header << "comment origin " << ox << " " << oy << " 0.000" << "\n";
+  header << "comment class 0=Building 1=Water 2=Bridge 3=Road 4=Terrain 5=Forest 6=Separation" << "\n";
+  header << "element vertex " << (unsigned long long)nvertices << "\n";
+  header << "property float x" << "\n";
+  header << "property float y" << "\n";
+  header << "property float z" << "\n";
+  header << "element face " << (unsigned long long)nfaces << "\n";
+  header << "property list uchar uint vertex_indices" << "\n";
+  header << "property uint feature" << "\n";
+  header << "property uchar class" << "\n";
+  header << "end_header" << "\n";
+  header.write(outputfile);
+  for (auto& vs : vertexbatches) {
+    outputfile.write(vs.data(), vs.size());
+    std::string().swap(vs);
   }
-  outputfile << ssf.str() << std::endl;
+  uint32_t offset = 0;
+  for (std::size_t b = 0; b < nbatches; b++) {
+    std::string& fs = facebatches[b];
+    for (std::size_t r = 0; r < fs.size(); r += 17) {
+      write_binary_uint8(outputfile, 3);
+      for (int k = 0; k < 3; k++) {
+        uint32_t v;
+        std::memcpy(&v, fs.data() + r + (4 * k), 4);
+        write_binary_uint32(outputfile, offset + v);
+      }
+      outputfile.write(fs.data() + r + 12, 5);
+    }
+    offset += uint32_t(nbatchvertices[b]);
+    std::string().swap(fs);
+  }
+  return true;
 }
 
-void Map3d::get_obj_per_class(std::ofstream &outputfile, int z_exaggeration) {
-  std::unordered_map< std::string, unsigned long > dPts;
-  std::stringstream ssf;
-  for (int c = 0; c < 6; c++) {
-    for (auto& p : _lsFeatures) {
-      if (p->get_class() == c) {
-        if (p->get_class() == BUILDING) {
-          Building* b = dynamic_cast<Building*>(p);
-          ssf << b->get_obj(dPts, _building_lod, b->get_mtl());
-        }
-        else {
-          ssf << p->get_obj(dPts, p->get_mtl());
-        }
+//-- binary STL: float32 coordinates relative to the min corner of the extent (written
+//-- in the 80-byte header), the triangles of all the features. The mesh of each feature
+//-- is built once, the number of triangles is written in the header at the end.
+bool Map3d::get_stl(std::ofstream &outputfile) {
+  double ox = bg::get<bg::min_corner, 0>(_bbox);
+  double oy = bg::get<bg::min_corner, 1>(_bbox);
+  OutputBuffer ss;
+  ss << "3dfier origin " << ox << " " << oy << " 0.000";
+  std::string header = ss.str();
+  header.resize(80, ' ');
+  outputfile.write(header.c_str(), 80);
+  std::streampos countpos = outputfile.tellp();
+  write_binary_uint32(outputfile, 0);
+  std::atomic<uint64_t> nfaces(0);
+  this->write_features(outputfile, [this, ox, oy, &nfaces](TopoFeature* f, std::string& s) {
+    std::vector<Point3> vertices;
+    std::vector<Triangle> triangles;
+    this->get_feature_mesh(f, vertices, triangles);
+    std::ostringstream fs;
+    for (auto& t : triangles) {
+      float p[3][3];
+      int vi[3] = { t.v0, t.v1, t.v2 };
+      for (int k = 0; k < 3; k++) {
+        p[k][0] = float(bg::get<0>(vertices[vi[k]]) - ox);
+        p[k][1] = float(bg::get<1>(vertices[vi[k]]) - oy);
+        p[k][2] = float(bg::get<2>(vertices[vi[k]]));
+      }
+      //-- unit normal from the orientation of the triangle
+      float u[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+      float v[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+      float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+      float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (int k = 0; k < 3; k++)
+        write_binary_float(fs, (len > 0) ? n[k] / len : 0.0f);
+      for (int k = 0; k < 3; k++) {
+        for (int c = 0; c < 3; c++)
+          write_binary_float(fs, p[k][c]);
       }
+      write_binary_uint16(fs, 0);
     }
+    nfaces += triangles.size();
+    s += fs.str();
+  });
+  if (nfaces > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << "ERROR: Too many triangles (" << nfaces << ") for the STL output, the maximum is " << std::numeric_limits<uint32_t>::max() << "." << std::endl;
+    return false;
   }
+  outputfile.seekp(countpos);
+  write_binary_uint32(outputfile, uint32_t(nfaces));
+  outputfile.seekp(0, std::ios::end);
+  return bool(outputfile);
+}
 
-  //-- sort the points in the map: simpler to copy to a vector
-  std::vector<std::string> thepts;
-  thepts.resize(dPts.size());
-  for (auto& p : dPts)
-    thepts[p.second - 1] = p.first;
-  dPts.clear();
+//-- a number with another precision than the 3 decimals of OutputBuffer, for the 3D Tiles
+static std::string get_number_string(double v, const char* format) {
+  char s[64];
+  std::snprintf(s, sizeof(s), format, v);
+  return std::string(s);
+}
 
-  outputfile << "mtllib ./3dfier.mtl" << std::endl;
-  for (auto& p : thepts) {
-    outputfile << "v " << p << std::endl;
+//-- transformation between two CRSs given by their EPSG codes, the coordinates being in
+//-- the x=easting/longitude, y=northing/latitude order of the input. A transformation is
+//-- not thread-safe, each thread creates its own.
+static std::unique_ptr<OGRCoordinateTransformation> create_transformation(int epsgfrom, int epsgto) {
+  OGRSpatialReference from, to;
+  if (from.importFromEPSG(epsgfrom) != OGRERR_NONE || to.importFromEPSG(epsgto) != OGRERR_NONE)
+    return std::unique_ptr<OGRCoordinateTransformation>();
+#if GDAL_VERSION_MAJOR >= 3
+  from.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+  to.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+  return std::unique_ptr<OGRCoordinateTransformation>(OGRCreateCoordinateTransformation(&from, &to));
+}
+
+//-- bounding region of 3D Tiles (west, south, east, north in radians, min and max ellipsoidal
+//-- heights) of a box of the input CRS between zmin and zmax. Its edges are sampled since they
+//-- are curved in longitude/latitude.
+static bool get_tileset_region(OGRCoordinateTransformation* togeographic, const Box2 &box, double zmin, double zmax, double region[6]) {
+  const int nsamples = 8;
+  std::vector<double> xs, ys, zs;
+  for (int i = 0; i <= nsamples; i++) {
+    double fx = bg::get<bg::min_corner, 0>(box) + i * (bg::get<bg::max_corner, 0>(box) - bg::get<bg::min_corner, 0>(box)) / nsamples;
+    double fy = bg::get<bg::min_corner, 1>(box) + i * (bg::get<bg::max_corner, 1>(box) - bg::get<bg::min_corner, 1>(box)) / nsamples;
+    double edges[4][2] = { { fx, bg::get<bg::min_corner, 1>(box) }, { fx, bg::get<bg::max_corner, 1>(box) },
+                           { bg::get<bg::min_corner, 0>(box), fy }, { bg::get<bg::max_corner, 0>(box), fy } };
+    for (int e = 0; e < 4; e++) {
+      for (double z : { zmin, zmax }) {
+        xs.push_back(edges[e][0]);
+        ys.push_back(edges[e][1]);
+        zs.push_back(z);
+      }
+    }
+  }
+  if (togeographic->Transform(int(xs.size()), xs.data(), ys.data(), zs.data()) != TRUE)
+    return false;
+  const double torad = 3.14159265358979323846 / 180.0;
+  region[0] = *std::min_element(xs.begin(), xs.end()) * torad;
+  region[1] = *std::min_element(ys.begin(), ys.end()) * torad;
+  region[2] = *std::max_element(xs.begin(), xs.end()) * torad;
+  region[3] = *std::max_element(ys.begin(), ys.end()) * torad;
+  region[4] = *std::min_element(zs.begin(), zs.end());
+  region[5] = *std::max_element(zs.begin(), zs.end());
+  return true;
+}
+
+//-- 3D Tiles: the features are put in square tiles of tilesize by the centre of their bbox,
+//-- each tile is a batched 3D model (b3dm) with one batch per feature, written in
+//-- <name>_tiles/ next to the tileset.json (outputfile). The vertices are transformed from the
+//-- CRS of the input (epsg) to ECEF (EPSG:4978), as 3D Tiles wants them, and the bounding
+//-- volumes are regions in longitude/latitude (EPSG:4979).
+bool Map3d::get_3dtiles(std::ofstream &outputfile, std::string filename, double tilesize, int epsg) {
+  if (!create_transformation(epsg, 4978) || !create_transformation(epsg, 4979)) {
+    std::cerr << "ERROR: Cannot transform the coordinates from EPSG:" << epsg << " to ECEF (EPSG:4978 and EPSG:4979)." << std::endl;
+    return false;
+  }
+  boost::filesystem::path tilesetpath(filename);
+  std::string tilesdirname = tilesetpath.stem().string() + "_tiles";
+  boost::filesystem::path tilesdir = tilesetpath.parent_path() / tilesdirname;
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(tilesdir, ec);
+  if (ec) {
+    std::cerr << "ERROR: Cannot create the directory " << tilesdir.string() << " for the tiles." << std::endl;
+    return false;
+  }
+  double xmin = bg::get<bg::min_corner, 0>(_bbox);
+  double ymin = bg::get<bg::min_corner, 1>(_bbox);
+  double xmax = bg::get<bg::max_corner, 0>(_bbox);
+  double ymax = bg::get<bg::max_corner, 1>(_bbox);
+  int ntx = std::max(1, int(std::ceil((xmax - xmin) / tilesize)));
+  int nty = std::max(1, int(std::ceil((ymax - ymin) / tilesize)));
+  std::vector<Box2> tiles(ntx * nty);
+  std::vector<double> tileszmin(ntx * nty, 0.0);
+  std::vector<double> tileszmax(ntx * nty, 0.0);
+  std::vector< std::array<double, 6> > tilesregions(ntx * nty);
+  std::vector<char> tileswritten(ntx * nty, 0);
+  std::atomic<bool> wentgood(true);
+  parallel_for(tiles.size(), _threads, [&](std::size_t i) {
+    int tx = int(i) % ntx;
+    int ty = int(i) / ntx;
+    Box2 tile(Point2(xmin + tx * tilesize, ymin + ty * tilesize),
+      Point2(std::min(xmin + (tx + 1) * tilesize, xmax), std::min(ymin + (ty + 1) * tilesize, ymax)));
+    //-- the features intersecting the tile, kept if the centre of their bbox is in it. They
+    //-- can stick out of the tile: its content is the union of their bboxes
+    std::vector<PairIndexed> candidates;
+    _rtree.query(bgi::intersects(tile), std::back_inserter(candidates));
+    std::vector<TopoFeature*> features;
+    Box2 content;
+    bg::assign_inverse(content);
+    for (auto& c : candidates) {
+      if (this->is_output_feature(c.second) == false)
+        continue;
+      Point2 centre;
+      bg::centroid(c.first, centre);
+      int cx = std::min(ntx - 1, int((bg::get<0>(centre) - xmin) / tilesize));
+      int cy = std::min(nty - 1, int((bg::get<1>(centre) - ymin) / tilesize));
+      if (cx == tx && cy == ty) {
+        features.push_back(c.second);
+        bg::expand(content, c.first);
+      }
+    }
+    if (features.empty())
+      return;
+    //-- same order as the features, for the batch ids
+    std::sort(features.begin(), features.end(), [](TopoFeature* a, TopoFeature* b) { return a->get_counter() < b->get_counter(); });
+    tiles[i] = content;
+    std::unique_ptr<OGRCoordinateTransformation> toecef = create_transformation(epsg, 4978);
+    std::unique_ptr<OGRCoordinateTransformation> togeographic = create_transformation(epsg, 4979);
+    boost::filesystem::path b3dm = tilesdir / (std::to_string(i) + ".b3dm");
+    if (!toecef || !togeographic || this->write_b3dm(b3dm.string(), features, (bg::get<bg::min_corner, 0>(content) + bg::get<bg::max_corner, 0>(content)) / 2,
+      (bg::get<bg::min_corner, 1>(content) + bg::get<bg::max_corner, 1>(content)) / 2, toecef.get(), tileszmin[i], tileszmax[i]) == false)
+      wentgood = false;
+    else if (get_tileset_region(togeographic.get(), content, tileszmin[i], tileszmax[i], tilesregions[i].data()) == false) {
+      std::lock_guard<std::mutex> lock(_logmutex);
+      std::cerr << "ERROR: Cannot transform the extent of the tile " << b3dm.string() << " to EPSG:4979." << std::endl;
+      wentgood = false;
+    }
+    else
+      tileswritten[i] = 1;
+  });
+  if (wentgood == false)
+    return false;
+
+  //-- the tileset: a root without content and the tiles as its children, the region of
+  //-- the root is the union of those of the tiles
+  std::array<double, 6> rootregion = { { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 } };
+  bool hastiles = false;
+  for (std::size_t i = 0; i < tiles.size(); i++) {
+    if (tileswritten[i] == 0)
+      continue;
+    if (hastiles == false)
+      rootregion = tilesregions[i];
+    for (int k = 0; k < 6; k++)
+      rootregion[k] = (k < 2 || k == 4) ? std::min(rootregion[k], tilesregions[i][k]) : std::max(rootregion[k], tilesregions[i][k]);
+    hastiles = true;
+  }
+  //-- the angles in radians with 10 decimals (< 1 mm), the heights in meters
+  auto region = [](OutputBuffer &ss, const std::array<double, 6> &r) {
+    ss << "{\"region\": [";
+    for (int k = 0; k < 4; k++)
+      ss << get_number_string(r[k], "%.10f") << ", ";
+    ss << r[4] << ", " << std::max(r[5], r[4] + 0.001) << "]}";
+  };
+  double geometricerror = std::sqrt((xmax - xmin) * (xmax - xmin) + (ymax - ymin) * (ymax - ymin));
+  OutputBuffer ss;
+  ss << "{" << "\n";
+  ss << "\"asset\": {\"version\": \"1.0\", \"generator\": \"3dfier\"}," << "\n";
+  ss << "\"geometricError\": " << geometricerror << "," << "\n";
+  ss << "\"root\": {" << "\n";
+  ss << "\"boundingVolume\": ";
+  region(ss, rootregion);
+  ss << "," << "\n";
+  ss << "\"geometricError\": " << geometricerror << "," << "\n";
+  ss << "\"refine\": \"ADD\"," << "\n";
+  ss << "\"children\": [" << "\n";
+  bool first = true;
+  for (std::size_t i = 0; i < tiles.size(); i++) {
+    if (tileswritten[i] == 0)
+      continue;
+    if (first == false)
+      ss << "," << "\n";
+    ss << "{\"boundingVolume\": ";
+    region(ss, tilesregions[i]);
+    ss << ", \"geometricError\": 0, \"content\": {\"uri\": \"" << tilesdirname << "/" << i << ".b3dm\"}}";
+    first = false;
+  }
+  ss << "\n" << "]" << "\n";
+  ss << "}" << "\n";
+  ss << "}" << "\n";
+  ss.write(outputfile);
+  return bool(outputfile);
+}
+
+//-- one tile of 3D Tiles: a b3dm with the batch table (ids and classes of the features) and a
+//-- binary glTF with one mesh of all the features. The triangles do not share their vertices,
+//-- so that each gets its own normal (flat shading). The vertices are transformed to ECEF
+//-- with toecef and are float32 relative to the ECEF of (cx, cy, 0) (RTC_CENTER), y up as
+//-- glTF wants it. zmin and zmax are those of the vertices in the CRS of the input.
+bool Map3d::write_b3dm(std::string filename, std::vector<TopoFeature*> &features, double cx, double cy, OGRCoordinateTransformation* toecef, double &zmin, double &zmax) {
+  static const char* classnames[] = { "Building", "Water", "Bridge", "Road", "Terrain", "Forest", "Separation" };
+  //-- the _BATCHID are unsigned short, as glTF does not allow unsigned int for the vertices
+  if (features.size() > std::numeric_limits<uint16_t>::max()) {
+    std::lock_guard<std::mutex> lock(_logmutex);
+    std::cerr << "ERROR: Too many features (" << features.size() << ") in the tile " << filename << ", the maximum is " << std::numeric_limits<uint16_t>::max() << " (decrease output.tileset_tile_size)." << std::endl;
+    return false;
+  }
+  double rtc[3] = { cx, cy, 0.0 };
+  if (toecef->Transform(1, &rtc[0], &rtc[1], &rtc[2]) != TRUE) {
+    std::lock_guard<std::mutex> lock(_logmutex);
+    std::cerr << "ERROR: Cannot transform the centre of the tile " << filename << " to ECEF." << std::endl;
+    return false;
+  }
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<uint16_t> batchids;
+  float pmin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+  float pmax[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+  zmin = std::numeric_limits<double>::max();
+  zmax = -std::numeric_limits<double>::max();
+  std::vector<Point3> vertices;
+  std::vector<Triangle> triangles;
+  std::vector<double> xs, ys, zs;
+  for (std::size_t k = 0; k < features.size(); k++) {
+    this->get_feature_mesh(features[k], vertices, triangles);
+    xs.resize(vertices.size());
+    ys.resize(vertices.size());
+    zs.resize(vertices.size());
+    for (std::size_t j = 0; j < vertices.size(); j++) {
+      xs[j] = bg::get<0>(vertices[j]);
+      ys[j] = bg::get<1>(vertices[j]);
+      zs[j] = bg::get<2>(vertices[j]);
+      zmin = std::min(zmin, zs[j]);
+      zmax = std::max(zmax, zs[j]);
+    }
+    if (vertices.empty() == false && toecef->Transform(int(vertices.size()), xs.data(), ys.data(), zs.data()) != TRUE) {
+      std::lock_guard<std::mutex> lock(_logmutex);
+      std::cerr << "ERROR: Cannot transform the vertices of " << features[k]->get_id() << " to ECEF." << std::endl;
+      return false;
+    }
+    for (auto& t : triangles) {
+      float p[3][3];
+      int vi[3] = { t.v0, t.v1, t.v2 };
+      for (int j = 0; j < 3; j++) {
+        //-- (X, Y, Z) z up is (X, Z, -Y) y up
+        p[j][0] = float(xs[vi[j]] - rtc[0]);
+        p[j][1] = float(zs[vi[j]] - rtc[2]);
+        p[j][2] = float(-(ys[vi[j]] - rtc[1]));
+      }
+      float u[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+      float v[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+      float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+      float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (len == 0)
+        continue;
+      for (int j = 0; j < 3; j++) {
+        for (int c = 0; c < 3; c++) {
+          positions.push_back(p[j][c]);
+          normals.push_back(n[c] / len);
+          pmin[c] = std::min(pmin[c], p[j][c]);
+          pmax[c] = std::max(pmax[c], p[j][c]);
+        }
+        batchids.push_back(uint16_t(k));
+      }
+    }
+  }
+  if (batchids.empty()) {
+    zmin = 0.0;
+    zmax = 0.0;
+    for (int c = 0; c < 3; c++) {
+      pmin[c] = 0.0f;
+      pmax[c] = 0.0f;
+    }
+  }
+  std::size_t count = batchids.size();
+
+  //-- glTF JSON chunk, padded with spaces to 4 bytes
+  OutputBuffer gltf;
+  gltf << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"3dfier\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],";
+  gltf << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"_BATCHID\":2},\"material\":0,\"mode\":4}]}],";
+  gltf << "\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorFactor\":[0.8,0.8,0.8,1.0],\"metallicFactor\":0.0,\"roughnessFactor\":1.0},\"doubleSided\":true}],";
+  gltf << "\"buffers\":[{\"byteLength\":" << (count * 28) << "}],";
+  gltf << "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << (count * 12) << ",\"target\":34962},";
+  gltf << "{\"buffer\":0,\"byteOffset\":" << (count * 12) << ",\"byteLength\":" << (count * 12) << ",\"target\":34962},";
+  gltf << "{\"buffer\":0,\"byteOffset\":" << (count * 24) << ",\"byteLength\":" << (count * 4) << ",\"byteStride\":4,\"target\":34962}],";
+  //-- the bounds of the positions exactly as float32 (%.9g), glTF validators compare them
+  gltf << "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":" << count << ",\"type\":\"VEC3\",";
+  gltf << "\"min\":[" << get_number_string(pmin[0], "%.9g") << "," << get_number_string(pmin[1], "%.9g") << "," << get_number_string(pmin[2], "%.9g") << "],";
+  gltf << "\"max\":[" << get_number_string(pmax[0], "%.9g") << "," << get_number_string(pmax[1], "%.9g") << "," << get_number_string(pmax[2], "%.9g") << "]},";
+  gltf << "{\"bufferView\":1,\"componentType\":5126,\"count\":" << count << ",\"type\":\"VEC3\"},";
+  gltf << "{\"bufferView\":2,\"componentType\":5123,\"count\":" << count << ",\"type\":\"SCALAR\"}]}";
+  std::string gltfjson = gltf.str();
+  gltfjson.resize((gltfjson.size() + 3) / 4 * 4, ' ');
+  uint32_t glblength = uint32_t(12 + 8 + gltfjson.size() + 8 + count * 28);
+
+  //-- b3dm feature table and batch table, padded with spaces so that the glb starts at 8 bytes
+  OutputBuffer ft;
+  ft << "{\"BATCH_LENGTH\":" << features.size() << ",\"RTC_CENTER\":[" << rtc[0] << "," << rtc[1] << "," << rtc[2] << "]}";
+  std::string featuretable = ft.str();
+  featuretable.resize((28 + featuretable.size() + 7) / 8 * 8 - 28, ' ');
+  OutputBuffer bt;
+  bt << "{\"id\":[";
+  for (std::size_t k = 0; k < features.size(); k++)
+    bt << ((k > 0) ? "," : "") << get_json_string(features[k]->get_id());
+  bt << "],\"class\":[";
+  for (std::size_t k = 0; k < features.size(); k++)
+    bt << ((k > 0) ? "," : "") << "\"" << classnames[features[k]->get_class()] << "\"";
+  bt << "]}";
+  std::string batchtable = bt.str();
+  batchtable.resize((28 + featuretable.size() + batchtable.size() + 7) / 8 * 8 - 28 - featuretable.size(), ' ');
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) {
+    std::cerr << "ERROR: Cannot write the tile " << filename << std::endl;
+    return false;
+  }
+  out.write("b3dm", 4);
+  write_binary_uint32(out, 1);
+  write_binary_uint32(out, uint32_t(28 + featuretable.size() + batchtable.size() + glblength));
+  write_binary_uint32(out, uint32_t(featuretable.size()));
+  write_binary_uint32(out, 0);
+  write_binary_uint32(out, uint32_t(batchtable.size()));
+  write_binary_uint32(out, 0);
+  out << featuretable << batchtable;
+  out.write("glTF", 4);
+  write_binary_uint32(out, 2);
+  write_binary_uint32(out, glblength);
+  write_binary_uint32(out, uint32_t(gltfjson.size()));
+  out.write("JSON", 4);
+  out << gltfjson;
+  write_binary_uint32(out, uint32_t(count * 28));
+  out.write("BIN\0", 4);
+  for (float f : positions)
+    write_binary_float(out, f);
+  for (float f : normals)
+    write_binary_float(out, f);
+  //-- each _BATCHID is padded to 4 bytes (byteStride of the vertex attributes)
+  for (uint16_t id : batchids) {
+    write_binary_uint16(out, id);
+    write_binary_uint16(out, 0);
   }
-  outputfile << ssf.str() << std::endl;
+  return bool(out);
 }
 
 bool Map3d::get_shapefile(std::string filename) {
@@ -358,42 +1140,142 @@ const std::vector<TopoFeature*>& Map3d::get_polygons3d() {
 }
 
 void Map3d::add_elevation_point(liblas::Point const& laspt) {
-  Point2 p(laspt.GetX(), laspt.GetY());
-  LAS14Class lasclass = LAS_UNKNOWN;
-  //-- get LAS class
-  if (laspt.GetClassification() == liblas::Classification(LAS_UNCLASSIFIED))
-    lasclass = LAS_UNCLASSIFIED;
-  else if (laspt.GetClassification() == liblas::Classification(LAS_GROUND))
-    lasclass = LAS_GROUND;
-  else if (laspt.GetClassification() == liblas::Classification(LAS_BUILDING))
-    lasclass = LAS_BUILDING;
-  else if (laspt.GetClassification() == liblas::Classification(LAS_WATER))
-    lasclass = LAS_WATER;
-  else if (laspt.GetClassification() == liblas::Classification(LAS_BRIDGE))
-    lasclass = LAS_BRIDGE;
-  else
-    lasclass = LAS_UNKNOWN;
+  this->add_elevation_point(get_lidarpoint(laspt, 0));
+}
 
-  std::vector<PairIndexed> re;
-  float radius = std::max(_radius_vertex_elevation, _building_radius_vertex_elevation);
-  Point2 minp(laspt.GetX() - radius, laspt.GetY() - radius);
-  Point2 maxp(laspt.GetX() + radius, laspt.GetY() + radius);
-  Box2 querybox(minp, maxp);
-  _rtree.query(bgi::intersects(querybox), std::back_inserter(re));
+LidarPoint Map3d::get_lidarpoint(liblas::Point const& laspt, uint32_t index) {
+  LidarPoint pt;
+  pt.index = index;
+  pt.x = laspt.GetX();
+  pt.y = laspt.GetY();
+  pt.z = laspt.GetZ();
+  pt.rawclass = laspt.GetClassification().GetClass();
+  pt.lasclass = get_las14class(pt.rawclass);
+  pt.lastreturn = (laspt.GetReturnNumber() == laspt.GetNumberOfReturns());
+  return pt;
+}
 
-  for (auto& v : re) {
-    TopoFeature* f = v.second;
+//-- thread-safe: the R-tree is only read, and the accumulators of a feature
+//-- are only modified while holding the lock of its stripe
+void Map3d::add_elevation_point(LidarPoint const& pt) {
+  if (_nodes.is_finalised())
+    _nodes.add_elevation_point(pt);
+  Point2 p(pt.x, pt.y);
+  std::vector<TopoFeature*> re;
+  if (_grid.is_built()) {
+    std::size_t col, row;
+    if (_grid.get_cell(pt.x, pt.y, col, row) == false)
+      return;
+    std::vector<TopoFeature*>::const_iterator fbegin, fend;
+    _grid.get_features(col, row, fbegin, fend);
+    re.assign(fbegin, fend);
+  }
+  else {
+    std::vector<PairIndexed> qre;
+    float radius = std::max(_radius_vertex_elevation, _building_radius_vertex_elevation);
+    Point2 minp(pt.x - radius, pt.y - radius);
+    Point2 maxp(pt.x + radius, pt.y + radius);
+    Box2 querybox(minp, maxp);
+    _rtree.query(bgi::intersects(querybox), std::back_inserter(qre));
+    for (auto& v : qre)
+      re.push_back(v.second);
+  }
+
+  for (auto& f : re) {
+    float radius;
     if (f->get_class() == BUILDING) {
       radius = _building_radius_vertex_elevation;
     }
     else {
       radius = _radius_vertex_elevation;
     }
+    std::lock_guard<std::mutex> lock(_featurelocks[f->get_counter() % NUM_FEATURE_LOCKS]);
     f->add_elevation_point(p,
-      laspt.GetZ(),
+      pt.z,
       radius,
-      lasclass,
-      (laspt.GetReturnNumber() == laspt.GetNumberOfReturns()));
+      pt.lasclass,
+      pt.lastreturn);
+  }
+}
+
+//-- routes a block of points at once. The points are sorted along a Z-order curve of cells,
+//-- the index is queried once per cell, and each candidate feature gets the points of
+//-- the cell as one contiguous span (and its lock is taken once for the whole span).
+//-- with the feature grid the cells are those of the grid, otherwise the R-tree is
+//-- queried with the bbox of the span.
+void Map3d::add_elevation_points(std::vector<LidarPoint> &block) {
+  float maxradius = std::max(_radius_vertex_elevation, _building_radius_vertex_elevation);
+  bool usegrid = _grid.is_built();
+  double ox = bg::get<bg::min_corner, 0>(_bbox) - maxradius;
+  double oy = bg::get<bg::min_corner, 1>(_bbox) - maxradius;
+  double cellsize = ROUTING_CELL_SIZE;
+  if (usegrid) {
+    ox = _grid.get_minx();
+    oy = _grid.get_miny();
+    cellsize = _grid.get_cell_size();
+  }
+  std::vector< std::pair<uint64_t, std::size_t> > codes;
+  codes.reserve(block.size());
+  for (std::size_t i = 0; i < block.size(); i++) {
+    if (usegrid) {
+      std::size_t col, row;
+      if (_grid.get_cell(block[i].x, block[i].y, col, row) == false)
+        continue; //-- no feature is there
+      codes.push_back(std::make_pair(morton_code(uint32_t(col), uint32_t(row)), i));
+    }
+    else {
+      uint32_t cx = uint32_t(std::max(0.0, (block[i].x - ox) / cellsize));
+      uint32_t cy = uint32_t(std::max(0.0, (block[i].y - oy) / cellsize));
+      codes.push_back(std::make_pair(morton_code(cx, cy), i));
+    }
+  }
+  std::sort(codes.begin(), codes.end());
+  std::vector<LidarPoint> pts(codes.size());
+  for (std::size_t i = 0; i < codes.size(); i++)
+    pts[i] = block[codes[i].second];
+  if (_nodes.is_finalised()) {
+    for (auto& pt : pts)
+      _nodes.add_elevation_point(pt);
+  }
+
+  std::vector<PairIndexed> qre;
+  std::vector<TopoFeature*> re;
+  std::size_t begin = 0;
+  while (begin < pts.size()) {
+    //-- the span of points in the same cell, and their bbox
+    double minx = pts[begin].x, maxx = pts[begin].x;
+    double miny = pts[begin].y, maxy = pts[begin].y;
+    std::size_t end = begin + 1;
+    while (end < pts.size() && codes[end].first == codes[begin].first) {
+      minx = std::min(minx, pts[end].x);
+      maxx = std::max(maxx, pts[end].x);
+      miny = std::min(miny, pts[end].y);
+      maxy = std::max(maxy, pts[end].y);
+      end++;
+    }
+    re.clear();
+    if (usegrid) {
+      std::size_t col, row;
+      _grid.get_cell(pts[begin].x, pts[begin].y, col, row);
+      std::vector<TopoFeature*>::const_iterator fbegin, fend;
+      _grid.get_features(col, row, fbegin, fend);
+      re.assign(fbegin, fend);
+    }
+    else {
+      Box2 querybox(Point2(minx - maxradius, miny - maxradius), Point2(maxx + maxradius, maxy + maxradius));
+      qre.clear();
+      _rtree.query(bgi::intersects(querybox), std::back_inserter(qre));
+      for (auto& v : qre)
+        re.push_back(v.second);
+    }
+    for (auto& f : re) {
+      float radius = _radius_vertex_elevation;
+      if (f->get_class() == BUILDING)
+        radius = _building_radius_vertex_elevation;
+      std::lock_guard<std::mutex> lock(_featurelocks[f->get_counter() % NUM_FEATURE_LOCKS]);
+      f->add_elevation_points(pts.begin() + begin, pts.begin() + end, radius);
+    }
+    begin = end;
   }
 }
 
@@ -405,37 +1287,59 @@ bool Map3d::threeDfy(bool stitching) {
     4. CDT
   */
   std::clog << "===== /LIFTING =====" << std::endl;
-  for (auto& f : _lsFeatures) {
-    f->lift();
-  }
+  auto starttime = std::chrono::steady_clock::now();
+  //-- each feature is lifted with its own points (the shared nodes are locked)
+  parallel_for(_lsFeatures.size(), _threads, [this](std::size_t i) {
+    _lsFeatures[i]->lift();
+  });
+  log_stage_duration("Lifting (" + std::to_string(_threads) + " threads)", starttime);
   std::clog << "===== LIFTING/ =====" << std::endl;
   if (stitching == true) {
     std::clog << "=====  /ADJACENT FEATURES =====" << std::endl;
-    for (auto& f : _lsFeatures) {
-      this->collect_adjacent_features(f);
-    }
+    starttime = std::chrono::steady_clock::now();
+    //-- the vertex index is used for the adjacency, the stitching and the twin edges
+    _vertexindex.build(_lsFeatures);
+    this->collect_adjacent_features();
+    log_stage_duration("Adjacent features", starttime);
     std::clog << "=====  ADJACENT FEATURES/ =====" << std::endl;
 
     std::clog << "=====  /STITCHING =====" << std::endl;
+    starttime = std::chrono::steady_clock::now();
     this->stitch_lifted_features();
-    std::clog << "=====  STITCHING/ =====" << std::endl;
 
     //-- Sort all node column vectors
-    for (auto& nc : _nc) {
-      std::sort(nc.second.begin(), nc.second.end());
-    }
+    _nc.for_each([](const CoordKey& key, std::vector<int>& nc) {
+      std::sort(nc.begin(), nc.end());
+    });
+
+    //-- the twin of each edge only depends on the geometry, they are found once for
+    //-- the bowties and the vertical walls
+    parallel_for(_lsFeatures.size(), _threads, [this](std::size_t i) {
+      _lsFeatures[i]->find_twin_edges(_vertexindex);
+    });
+    log_stage_duration("Stitching", starttime);
+    std::clog << "=====  STITCHING/ =====" << std::endl;
 
     std::clog << "=====  /BOWTIES =====" << std::endl;
+    starttime = std::chrono::steady_clock::now();
     // TODO: shouldn't bowties be fixed after the VW? or at same time?
+    //-- serial: fix_bowtie() also changes the elevations of the adjacent features
     for (auto& f : _lsFeatures) {
       if (f->has_vertical_walls() == true) {
         f->fix_bowtie();
       }
     }
+    log_stage_duration("Bowties", starttime);
     std::clog << "=====  BOWTIES/ =====" << std::endl;
 
+    //-- in tiled mode, the vertices shared with the features written by the previous tiles
+    this->apply_decided_heights();
+
     std::clog << "=====  /VERTICAL WALLS =====" << std::endl;
-    for (auto& f : _lsFeatures) {
+    starttime = std::chrono::steady_clock::now();
+    //-- each feature only reads the node columns and the elevations, and writes its own walls
+    parallel_for(_lsFeatures.size(), _threads, [this](std::size_t i) {
+      TopoFeature* f = _lsFeatures[i];
       if (f->has_vertical_walls() == true) {
         int baseheight = 0;
         if (f->get_class() == BUILDING) {
@@ -443,7 +1347,8 @@ bool Map3d::threeDfy(bool stitching) {
         }
         f->construct_vertical_walls(_nc, baseheight);
       }
-    }
+    });
+    log_stage_duration("Vertical walls", starttime);
     std::clog << "=====  VERTICAL WALLS/ =====" << std::endl;
   }
   return true;
@@ -451,23 +1356,45 @@ bool Map3d::threeDfy(bool stitching) {
 
 bool Map3d::construct_CDT() {
   std::clog << "=====  /CDT =====" << std::endl;
-  for (auto& p : _lsFeatures) {
-    // std::clog << p->get_id() << " (" << p->get_class() << ")" << std::endl;
-    p->buildCDT();
-  }
+  auto starttime = std::chrono::steady_clock::now();
+  //-- the triangulations are independent: the features are handed out to the threads
+  //-- from the most expensive to the cheapest, so a large TIN is not started last
+  std::vector< std::pair<std::size_t, std::size_t> > costs;
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++)
+    costs.push_back(std::make_pair(_lsFeatures[i]->get_cdt_cost(), i));
+  std::stable_sort(costs.begin(), costs.end(), [](const std::pair<std::size_t, std::size_t>& a, const std::pair<std::size_t, std::size_t>& b) {
+    return a.first > b.first;
+  });
+  parallel_for(costs.size(), _threads, [this, &costs](std::size_t i) {
+    _lsFeatures[costs[i].second]->buildCDT();
+  });
+  log_stage_duration("CDT (" + std::to_string(_threads) + " threads)", starttime);
   std::clog << "=====  CDT/ =====" << std::endl;
   return true;
 }
 
 bool Map3d::construct_rtree() {
   std::clog << "Constructing the R-tree...";
+  auto starttime = std::chrono::steady_clock::now();
   for (auto p : _lsFeatures)
     _rtree.insert(std::make_pair(p->get_bbox2d(), p));
-  std::clog << " done." << std::endl;
+  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - starttime;
+  std::clog << " done (" << duration.count() << " s)." << std::endl;
 
   //-- update the bounding box from the r-tree
   _bbox = Box2(Point2(bg::get<bg::min_corner, 0>(_rtree.bounds()), bg::get<bg::min_corner, 1>(_rtree.bounds())),
     Point2(bg::get<bg::max_corner, 0>(_rtree.bounds()), bg::get<bg::max_corner, 1>(_rtree.bounds())));
+
+  //-- the grid is used for routing the points, the R-tree stays for the other queries
+  if (_use_feature_grid && !_lsFeatures.empty()) {
+    std::clog << "Constructing the feature grid...";
+    starttime = std::chrono::steady_clock::now();
+    _grid.build(_lsFeatures, _bbox, _radius_vertex_elevation, _building_radius_vertex_elevation);
+    duration = std::chrono::steady_clock::now() - starttime;
+    std::clog << " done (" << duration.count() << " s, "
+      << _grid.get_num_cells() << " cells of " << _grid.get_cell_size() << " m, "
+      << (_grid.get_memory_usage() / (1024 * 1024)) << " MB)." << std::endl;
+  }
   return true;
 }
 
@@ -550,8 +1477,8 @@ bool Map3d::extract_and_add_polygon(GDALDataset* dataSource, PolygonFile* file)
     OGREnvelope envelope = OGREnvelope();
     if (boost::geometry::area(_requestedExtent) > 0) {
       envelope.MinX = bg::get<bg::min_corner, 0>(_requestedExtent);
-      envelope.MaxX = bg::get<bg::max_corner, 1>(_requestedExtent);
-      envelope.MinY = bg::get<bg::min_corner, 0>(_requestedExtent);
+      envelope.MaxX = bg::get<bg::max_corner, 0>(_requestedExtent);
+      envelope.MinY = bg::get<bg::min_corner, 1>(_requestedExtent);
       envelope.MaxY = bg::get<bg::max_corner, 1>(_requestedExtent);
       useRequestedExtent = true;
     }
@@ -655,8 +1582,213 @@ void Map3d::extract_feature(OGRFeature *f, std::string layername, const char *id
   }
 }
 
-//-- http://www.liblas.org/tutorial/cpp.html#applying-filters-to-a-reader-to-extract-specified-classes
-bool Map3d::add_las_file(std::string ifile, std::vector<int> lasomits, int skip) {
+//-- which points the classes of features present can use, following the rules of
+//-- the add_elevation_point() of each class. Points no feature uses are dropped when
+//-- read, before they reach the spatial index.
+void Map3d::set_point_demand() {
+  std::set<TopoClass> classes;
+  for (auto& f : _lsFeatures)
+    classes.insert(f->get_class());
+  //-- indexed by the class in the LAS file, only the standard ones (0-18) are used
+  for (int raw = 0; raw < 256; raw++) {
+    _pointdemand[raw] = 0;
+    if (raw > 18)
+      continue;
+    LAS14Class c = get_las14class(raw);
+    unsigned char demand = 0;
+    if (classes.count(WATER) > 0)
+      demand |= DEMAND_ANY_RETURN;
+    if (classes.count(BUILDING) > 0)
+      demand |= DEMAND_LAST_RETURN;
+    if ((classes.count(TERRAIN) > 0 || classes.count(ROAD) > 0) && c == LAS_GROUND)
+      demand |= DEMAND_LAST_RETURN;
+    if (classes.count(FOREST) > 0 && ((_forest_ground_points_only && c == LAS_GROUND) || (_forest_ground_points_only == false && c != LAS_BUILDING)))
+      demand |= DEMAND_LAST_RETURN;
+    if ((classes.count(SEPARATION) > 0 || classes.count(BRIDGE) > 0) && c != LAS_BUILDING && c != LAS_WATER)
+      demand |= DEMAND_LAST_RETURN;
+    _pointdemand[raw] = demand;
+  }
+}
+
+//-- the demand for the points of one file: the classes it omits are never used
+void Map3d::get_point_demand(PointFile &file, unsigned char demand[256]) {
+  std::memcpy(demand, _pointdemand, 256);
+  for (int i : file.lasomits) {
+    if (i >= 0 && i < 256)
+      demand[i] = 0;
+  }
+}
+
+//-- the features that sample the points at their vertices share one node per vertex
+void Map3d::construct_node_table() {
+  for (auto& f : _lsFeatures) {
+    switch (f->get_class()) {
+    case TERRAIN:
+    case ROAD:
+      f->set_nodes(&_nodes, NODE_GROUND_LAST);
+      break;
+    case FOREST:
+      f->set_nodes(&_nodes, _forest_ground_points_only ? NODE_GROUND_LAST : NODE_NOT_BUILDING_LAST);
+      break;
+    case SEPARATION:
+      f->set_nodes(&_nodes, NODE_NOT_BUILDING_NOT_WATER_LAST);
+      break;
+    default:
+      break;
+    }
+  }
+  _nodes.finalise(_radius_vertex_elevation);
+  std::clog << "Shared nodes for the vertices: " << boost::locale::as::number << _nodes.get_num_nodes() << std::endl;
+}
+
+bool Map3d::add_las_files(std::vector<PointFile> &files) {
+  this->set_point_demand();
+  if (_use_shared_nodes && _nodes.is_finalised() == false)
+    this->construct_node_table();
+  //-- split the files in intervals of points that can be decoded independently
+  //-- with the point cache, the files already cached are read from there instead
+  std::vector<PointInterval> intervals;
+  std::vector<char> needindex(files.size(), 0);
+  std::vector< std::unique_ptr<PointCacheReader> > cachereaders(files.size());
+  std::vector< std::unique_ptr<PointCacheWriter> > cachewriters(files.size());
+  bool wentgoodheaders = true;
+  for (std::size_t fi = 0; fi < files.size(); fi++) {
+    if (_point_cache.empty() == false) {
+      std::string key, cachefile;
+      try {
+        key = get_point_cache_key(files[fi]);
+        cachefile = get_point_cache_filename(_point_cache, key);
+      }
+      catch (boost::filesystem::filesystem_error &e) {
+        key.clear();
+      }
+      if (key.empty() == false) {
+        cachereaders[fi].reset(new PointCacheReader());
+        if (cachereaders[fi]->open(cachefile, key)) {
+          //-- only the blocks of the cache overlapping the polygons are read
+          uint64_t n = cachereaders[fi]->get_num_points();
+          liblas::Bounds<double> polygonBounds = get_bounds();
+          Box2 polygonBox(Point2(polygonBounds.minx(), polygonBounds.miny()), Point2(polygonBounds.maxx(), polygonBounds.maxy()));
+          std::size_t nskipped = 0;
+          std::clog << "Reading LAS/LAZ file from the point cache: " << files[fi].filename << std::endl;
+          std::clog << "\t(" << boost::locale::as::number << n << " points in " << cachefile << ")" << std::endl;
+          for (uint64_t b = 0; b < cachereaders[fi]->get_num_blocks(); b++) {
+            PointInterval interval;
+            interval.fileid = fi;
+            interval.start = uint32_t(b * POINT_CACHE_BLOCK_SIZE);
+            interval.count = uint32_t(std::min(uint64_t(POINT_CACHE_BLOCK_SIZE), n - interval.start));
+            interval.step = POINT_CACHE_BLOCK_SIZE;
+            interval.total = uint32_t(n);
+            interval.bounds = cachereaders[fi]->get_block_bounds(b);
+            interval.hasbounds = true;
+            interval.complete = false;
+            interval.fromcache = true;
+            if (bg::intersects(interval.bounds, polygonBox) == false) {
+              nskipped++;
+              continue;
+            }
+            intervals.push_back(interval);
+          }
+          if (nskipped > 0)
+            std::clog << "\t(skipping " << nskipped << " of " << cachereaders[fi]->get_num_blocks() << " blocks of the cache outside the polygon extent)" << std::endl;
+          continue;
+        }
+        cachereaders[fi].reset();
+        cachewriters[fi].reset(new PointCacheWriter());
+        if (cachewriters[fi]->open(cachefile, key) == false) {
+          std::cerr << "\tWARNING: could not write to the point cache: " << cachefile << std::endl;
+          cachewriters[fi].reset();
+        }
+      }
+    }
+    //-- the whole file is read when it is cached, whatever the polygons
+    bool need = false;
+    std::size_t nintervals = intervals.size();
+    if (this->get_las_intervals(files[fi], fi, intervals, need, bool(cachewriters[fi])) == false)
+      wentgoodheaders = false;
+    needindex[fi] = need;
+    if (cachewriters[fi] && intervals.size() == nintervals) {
+      cachewriters[fi]->discard();
+      cachewriters[fi].reset();
+    }
+  }
+  std::vector< std::atomic<int> > remaining(files.size());
+  for (auto& r : remaining)
+    r = 0;
+  for (auto& interval : intervals)
+    remaining[interval.fileid]++;
+
+  //-- the readers decode the intervals in blocks of points, the workers route the blocks to the features
+  BlockingQueue< std::vector<LidarPoint> > blocks(2 * _threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < _threads; t++) {
+    workers.push_back(std::thread([this, &blocks]() {
+      std::vector<LidarPoint> block;
+      while (blocks.pop(block)) {
+        this->add_elevation_points(block);
+      }
+    }));
+  }
+  //-- each reader takes the next interval to read until all are read; the intervals
+  //-- of one file can thus be decoded by several readers at the same time
+  int nreaders = std::max(1, std::min(_max_concurrent_files, int(intervals.size())));
+  bool progressbar = (nreaders == 1);
+  std::atomic<int> nextinterval(0);
+  std::atomic<bool> wentgood(wentgoodheaders);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < nreaders; r++) {
+    readers.push_back(std::thread([this, &files, &intervals, &remaining, &needindex, &cachereaders, &cachewriters, &blocks, &nextinterval, &wentgood, progressbar]() {
+      int ii;
+      while ((ii = nextinterval++) < int(intervals.size())) {
+        PointInterval& interval = intervals[ii];
+        if (interval.fromcache)
+          this->read_cache_interval(files[interval.fileid], *cachereaders[interval.fileid], interval, blocks);
+        else if (this->read_las_interval(files[interval.fileid], interval, blocks, cachewriters[interval.fileid].get(), progressbar) == false)
+          wentgood = false;
+        if (--remaining[interval.fileid] == 0) {
+          if (needindex[interval.fileid])
+            this->save_las_index(files[interval.fileid], interval.fileid, intervals);
+          //-- the cache is only kept if the file was read completely
+          if (cachewriters[interval.fileid]) {
+            bool complete = true;
+            for (auto& other : intervals) {
+              if (other.fileid == interval.fileid && other.complete == false)
+                complete = false;
+            }
+            if (complete)
+              cachewriters[interval.fileid]->close();
+            else
+              cachewriters[interval.fileid]->discard();
+          }
+          std::lock_guard<std::mutex> lock(_logmutex);
+          if (progressbar) {
+            printProgressBar(100);
+            std::clog << "done" << std::endl;
+          }
+          else
+            std::clog << "Done reading LAS/LAZ file: " << files[interval.fileid].filename << std::endl;
+        }
+      }
+    }));
+  }
+  for (auto& r : readers)
+    r.join();
+  //-- let the workers finish the blocks already decoded
+  blocks.close();
+  for (auto& w : workers)
+    w.join();
+  return wentgood;
+}
+
+//-- reads the header of the file and splits its points in intervals that can be decoded
+//-- independently. For LAZ the intervals are aligned on the chunks of LASzip: each chunk
+//-- is compressed on its own and the reader seeks to it with the chunk table.
+//-- if the file has an index (see save_las_index(), or a .lax of LAStools) the intervals
+//-- outside the bounds of the polygons are not read, otherwise needindex tells to build
+//-- it while reading (only if options.las_index_dir is set).
+bool Map3d::get_las_intervals(PointFile &file, std::size_t fileid, std::vector<PointInterval> &intervals, bool &needindex, bool readall) {
+  std::string ifile = file.filename;
+  int skip = file.thinning;
   std::clog << "Reading LAS/LAZ file: " << ifile << std::endl;
   std::ifstream ifs;
   ifs.open(ifile.c_str(), std::ios::in | std::ios::binary);
@@ -664,47 +1796,20 @@ bool Map3d::add_las_file(std::string ifile, std::vector<int> lasomits, int skip)
     std::cerr << "\tERROR: could not open file: " << ifile << std::endl;
     return false;
   }
-  //-- LAS classes to omit (create full list since eExclusion does not work
-  std::vector<liblas::Classification> liblasomits{
-    liblas::Classification(0), liblas::Classification(1), liblas::Classification(2), liblas::Classification(3),
-    liblas::Classification(4), liblas::Classification(5), liblas::Classification(6), liblas::Classification(7),
-    liblas::Classification(8), liblas::Classification(9), liblas::Classification(10), liblas::Classification(11),
-    liblas::Classification(12), liblas::Classification(13), liblas::Classification(14), liblas::Classification(15),
-    liblas::Classification(16), liblas::Classification(17), liblas::Classification(18)
-  };
-  for (int i : lasomits)
-    liblasomits.erase(std::find(liblasomits.begin(), liblasomits.end(), liblas::Classification(i)));
-  //-- read each point 1-by-1
-  liblas::ReaderFactory f;
-  liblas::Reader reader = f.CreateWithStream(ifs);
-  liblas::Header const& header = reader.GetHeader();
-
-  //-- check if the file overlaps the polygons
-  liblas::Bounds<double> bounds = header.GetExtent();
-  liblas::Bounds<double> polygonBounds = get_bounds();
-  uint32_t pointCount = header.GetPointRecordsCount();
-  if (polygonBounds.intersects(bounds)) {
-    std::vector<liblas::FilterPtr> filters;
-
-    //-- set the class filter
-    liblas::FilterPtr class_filter = liblas::FilterPtr(new liblas::ClassificationFilter(liblasomits));
-    // eExclusion would throw out those that matched
-    class_filter->SetType(liblas::FilterI::eInclusion);
-    filters.push_back(class_filter);
-
-    //-- set the bounds filter
-    liblas::FilterPtr bounds_filter = liblas::FilterPtr(new liblas::BoundsFilter(polygonBounds));
-    bounds_filter->SetType(liblas::FilterI::eInclusion);
-    filters.push_back(bounds_filter);
-
-    //-- set the thinning filter if thinning is set
-    if (skip > 1) {
-      liblas::FilterPtr thinning_filter = liblas::FilterPtr(new liblas::ThinFilter(skip));
-      thinning_filter->SetType(liblas::FilterI::eInclusion);
-      filters.push_back(thinning_filter);
+  try {
+    liblas::ReaderFactory f;
+    liblas::Reader reader = f.CreateWithStream(ifs);
+    liblas::Header const& header = reader.GetHeader();
+
+    //-- check if the file overlaps the polygons
+    liblas::Bounds<double> bounds = header.GetExtent();
+    liblas::Bounds<double> polygonBounds = get_bounds();
+    uint32_t pointCount = header.GetPointRecordsCount();
+    if (polygonBounds.intersects(bounds) == false) {
+      std::clog << "\tskipping file, bounds do not intersect polygon extent" << std::endl;
+      ifs.close();
+      return true;
     }
-    reader.SetFilters(filters);
-
     std::clog << "\t(" << boost::locale::as::number << pointCount << " points in the file)" << std::endl;
     if ((skip > 1)) {
       std::clog << "\t(skipping every " << skip << "th points, thus ";
@@ -713,144 +1818,399 @@ bool Map3d::add_las_file(std::string ifile, std::vector<int> lasomits, int skip)
     else
       std::clog << "\t(all points used, no skipping)" << std::endl;
 
-    if (lasomits.empty() == false) {
+    if (file.lasomits.empty() == false) {
       std::clog << "\t(omitting LAS classes: ";
-      for (int i : lasomits)
+      for (int i : file.lasomits)
         std::clog << i << " ";
       std::clog << ")" << std::endl;
     }
-    printProgressBar(0);
-    int i = 0;
-    try {
-      while (reader.ReadNextPoint()) {
-        this->add_elevation_point(reader.GetPoint());
 
-        if (i % (pointCount / 100) == 0)
-          printProgressBar(100 * (i / double(pointCount)));
-        i++;
+    //-- LAZ files without fixed-size chunks can only be decoded sequentially
+    uint32_t step = POINT_INTERVAL_SIZE;
+    if (header.Compressed()) {
+      uint32_t chunksize = get_laszip_chunk_size(header);
+      if (chunksize == 0)
+        step = std::max(pointCount, uint32_t(1));
+      else
+        step = std::max(uint32_t(1), POINT_INTERVAL_SIZE / chunksize) * chunksize;
+    }
+    std::vector<Box2> indexbounds;
+    bool hasindex = false;
+    if (_use_las_index) {
+      //-- the index of 3dfier has the exact bounds of the intervals, that of LAStools those of its cells
+      if (_las_index_dir.empty() == false)
+        hasindex = read_las_index(get_las_index_filename(_las_index_dir, ifile), ifile, pointCount, step, indexbounds);
+      if (hasindex == false)
+        hasindex = read_lax_index(ifile, pointCount, step, indexbounds);
+      if (hasindex && indexbounds.size() != std::size_t((uint64_t(pointCount) + step - 1) / step))
+        hasindex = false;
+      needindex = (hasindex == false && _las_index_dir.empty() == false);
+    }
+    Box2 polygonBox(Point2(polygonBounds.minx(), polygonBounds.miny()), Point2(polygonBounds.maxx(), polygonBounds.maxy()));
+    std::size_t nskipped = 0;
+    std::size_t ii = 0;
+    for (uint64_t start = 0; start < pointCount; start += step, ii++) {
+      PointInterval interval;
+      interval.fileid = fileid;
+      interval.start = uint32_t(start);
+      interval.count = uint32_t(std::min(uint64_t(step), pointCount - start));
+      interval.step = step;
+      interval.total = pointCount;
+      interval.hasbounds = hasindex;
+      interval.complete = false;
+      interval.fromcache = false;
+      if (hasindex) {
+        interval.bounds = indexbounds[ii];
+        if (readall == false && bg::intersects(interval.bounds, polygonBox) == false) {
+          nskipped++;
+          continue;
+        }
       }
-      printProgressBar(100);
-      std::clog << "done" << std::endl;
+      intervals.push_back(interval);
     }
-    catch (std::exception e) {
-      std::cerr << std::endl << e.what() << std::endl;
+    if (nskipped > 0)
+      std::clog << "\t(index: skipping " << nskipped << " of " << ii << " parts of the file outside the polygon extent)" << std::endl;
+  }
+  catch (const std::exception& e) {
+    std::cerr << std::endl << ifile << ": " << e.what() << std::endl;
+    ifs.close();
+    return false;
+  }
+  ifs.close();
+  return true;
+}
+
+//-- http://www.liblas.org/tutorial/cpp.html
+//-- thread-safe: each interval is read with its own stream and reader. The class, bounds and
+//-- thinning filters are applied here (not with liblas filters) so that the number of points
+//-- read in the interval is known. The thinning keeps the points whose position in the file
+//-- is a multiple of the factor, whatever the intervals, the other filters or the cache.
+bool Map3d::read_las_interval(PointFile &file, PointInterval &interval, BlockingQueue< std::vector<LidarPoint> > &blocks, PointCacheWriter* cache, bool progressbar) {
+  std::string ifile = file.filename;
+  int skip = file.thinning;
+  std::ifstream ifs;
+  ifs.open(ifile.c_str(), std::ios::in | std::ios::binary);
+  if (ifs.is_open() == false) {
+    std::lock_guard<std::mutex> lock(_logmutex);
+    std::cerr << "\tERROR: could not open file: " << ifile << std::endl;
+    return false;
+  }
+  unsigned char demand[256];
+  this->get_point_demand(file, demand);
+  liblas::Bounds<double> polygonBounds = get_bounds();
+  double minx = polygonBounds.minx();
+  double miny = polygonBounds.miny();
+  double maxx = polygonBounds.maxx();
+  double maxy = polygonBounds.maxy();
+  try {
+    liblas::ReaderFactory f;
+    liblas::Reader reader = f.CreateWithStream(ifs);
+    if (interval.start > 0 && reader.Seek(interval.start) == false) {
+      std::lock_guard<std::mutex> lock(_logmutex);
+      std::cerr << "\tERROR: could not seek to point " << interval.start << " in file: " << ifile << std::endl;
       ifs.close();
       return false;
     }
+    if (progressbar && interval.start == 0) {
+      std::lock_guard<std::mutex> lock(_logmutex);
+      printProgressBar(0);
+    }
+    uint32_t progressstep = std::max(uint32_t(1), interval.total / 100);
+    uint32_t nread = 0;
+    double bminx = 1e20, bminy = 1e20, bmaxx = -1e20, bmaxy = -1e20;
+    std::vector<LidarPoint> block;
+    std::vector<LidarPoint> cacheblock;
+    block.reserve(POINT_BLOCK_SIZE);
+    for (uint32_t i = 0; i < interval.count && reader.ReadNextPoint(); i++) {
+      liblas::Point const& laspt = reader.GetPoint();
+      if (progressbar && (interval.start + i) % progressstep == 0)
+        printProgressBar(100 * ((interval.start + i) / double(interval.total)));
+      double x = laspt.GetX();
+      double y = laspt.GetY();
+      nread++;
+      if (interval.hasbounds == false) {
+        bminx = std::min(bminx, x);
+        bminy = std::min(bminy, y);
+        bmaxx = std::max(bmaxx, x);
+        bmaxy = std::max(bmaxy, y);
+      }
+      uint32_t index = interval.start + i;
+      //-- the cache keeps all the points of the file, the filters are applied when it is read
+      if (cache != NULL && laspt.GetClassification().GetClass() <= 18) {
+        cacheblock.push_back(get_lidarpoint(laspt, index));
+        if (cacheblock.size() == POINT_BLOCK_SIZE) {
+          cache->add_points(cacheblock);
+          cacheblock.clear();
+        }
+      }
+      if (skip > 1 && (index % skip) != 0)
+        continue;
+      if (is_point_demanded(demand, laspt.GetClassification().GetClass(), laspt.GetReturnNumber() == laspt.GetNumberOfReturns()) == false)
+        continue;
+      if (x < minx || x > maxx || y < miny || y > maxy)
+        continue;
+      block.push_back(get_lidarpoint(laspt, index));
+      if (block.size() == POINT_BLOCK_SIZE) {
+        blocks.push(std::move(block));
+        block = std::vector<LidarPoint>();
+        block.reserve(POINT_BLOCK_SIZE);
+      }
+    }
+    if (cacheblock.empty() == false)
+      cache->add_points(cacheblock);
+    if (block.empty() == false)
+      blocks.push(std::move(block));
+    if (interval.hasbounds == false && nread > 0) {
+      interval.bounds = Box2(Point2(bminx, bminy), Point2(bmaxx, bmaxy));
+      interval.hasbounds = true;
+    }
+    interval.complete = (nread == interval.count);
   }
-  else {
-    std::clog << "\tskipping file, bounds do not intersect polygon extent" << std::endl;
+  catch (const std::exception& e) {
+    std::lock_guard<std::mutex> lock(_logmutex);
+    std::cerr << std::endl << ifile << ": " << e.what() << std::endl;
+    ifs.close();
+    return false;
   }
   ifs.close();
   return true;
 }
 
-void Map3d::collect_adjacent_features(TopoFeature* f) {
-  std::vector<PairIndexed> re;
-  _rtree.query(bgi::intersects(f->get_bbox2d()), std::back_inserter(re));
-  for (auto& each : re) {
-    TopoFeature* fadj = each.second;
-    if (f != fadj && (bg::touches(*(f->get_Polygon2()), *(fadj->get_Polygon2())) || !bg::disjoint(*(f->get_Polygon2()), *(fadj->get_Polygon2())))) {
-      f->add_adjacent_feature(fadj);
-    }
+//-- the cache holds all the points of the file (see PointCacheWriter), the same filters
+//-- as in read_las_interval() are thus applied here. The thinning is on the position of
+//-- the points in the file, kept in the cache, so the same points are kept as without it.
+void Map3d::read_cache_interval(PointFile &file, PointCacheReader &cache, PointInterval &interval, BlockingQueue< std::vector<LidarPoint> > &blocks) {
+  int skip = file.thinning;
+  unsigned char demand[256];
+  this->get_point_demand(file, demand);
+  liblas::Bounds<double> polygonBounds = get_bounds();
+  double minx = polygonBounds.minx();
+  double miny = polygonBounds.miny();
+  double maxx = polygonBounds.maxx();
+  double maxy = polygonBounds.maxy();
+  uint64_t end = uint64_t(interval.start) + interval.count;
+  for (uint64_t start = interval.start; start < end; start += POINT_BLOCK_SIZE) {
+    std::vector<LidarPoint> block;
+    cache.get_points(start, std::min(uint64_t(POINT_BLOCK_SIZE), end - start), block);
+    block.erase(std::remove_if(block.begin(), block.end(), [&](LidarPoint const& pt) {
+      if (skip > 1 && (pt.index % skip) != 0)
+        return true;
+      if (is_point_demanded(demand, pt.rawclass, pt.lastreturn) == false)
+        return true;
+      return (pt.x < minx || pt.x > maxx || pt.y < miny || pt.y > maxy);
+    }), block.end());
+    if (block.empty() == false)
+      blocks.push(std::move(block));
   }
+  interval.complete = true;
+}
+
+//-- writes the bounds of the intervals of the file, once all of them are read, so that
+//-- the next time only the intervals overlapping the polygons are read
+void Map3d::save_las_index(PointFile &file, std::size_t fileid, std::vector<PointInterval> &intervals) {
+  std::vector<Box2> bounds;
+  uint32_t pointcount = 0;
+  uint32_t step = 0;
+  for (auto& interval : intervals) {
+    if (interval.fileid != fileid)
+      continue;
+    if (interval.complete == false || interval.hasbounds == false)
+      return;
+    step = interval.step;
+    pointcount = interval.total;
+    bounds.push_back(interval.bounds);
+  }
+  if (bounds.empty())
+    return;
+  if (write_las_index(get_las_index_filename(_las_index_dir, file.filename), file.filename, pointcount, step, bounds) == false) {
+    std::lock_guard<std::mutex> lock(_logmutex);
+    std::cerr << "\tWARNING: could not write the index of file: " << file.filename << std::endl;
+  }
+}
+
+//-- features sharing a vertex are adjacent, without testing their geometries. The other
+//-- candidates of the R-tree are tested with bg::intersects() (touches() or !disjoint()):
+//-- the input is not always a clean planar partition, and a feature can touch another one
+//-- along an edge or at a vertex of only one of them.
+void Map3d::collect_adjacent_features() {
+  std::size_t n = _lsFeatures.size();
+  std::vector< std::vector<TopoFeature*> > shared(n);
+  parallel_for(n, _threads, [&](std::size_t i) {
+    _vertexindex.get_shared_vertices(_lsFeatures[i], shared[i]);
+  });
+  //-- the candidates are in the order of the R-tree as before, it is the order of the stitching
+  parallel_for(n, _threads, [&](std::size_t i) {
+    TopoFeature* f = _lsFeatures[i];
+    std::vector<PairIndexed> re;
+    _rtree.query(bgi::intersects(f->get_bbox2d()), std::back_inserter(re));
+    for (auto& each : re) {
+      TopoFeature* fadj = each.second;
+      if (f == fadj)
+        continue;
+      bool adjacent = std::binary_search(shared[i].begin(), shared[i].end(), fadj);
+      if (adjacent == false)
+        adjacent = bg::intersects(*(f->get_Polygon2()), *(fadj->get_Polygon2()));
+      if (adjacent == true)
+        f->add_adjacent_feature(fadj);
+    }
+  });
 }
 
 void Map3d::stitch_lifted_features() {
-  std::vector<int> ringis, pis;
-  for (auto& f : _lsFeatures) {
-    //-- 1. store all touching top level (adjacent + incident)
-    std::vector<TopoFeature*>* lstouching = f->get_adjacent_features();
-
-    //-- 2. build the node-column for each vertex
-    // oring
-    Ring2 oring = bg::exterior_ring(*(f->get_Polygon2()));
-    for (int i = 0; i < oring.size(); i++) {
-      // std::cout << std::setprecision(3) << std::fixed << bg::get<0>(oring[i]) << " : " << bg::get<1>(oring[i]) << std::endl;
+  if (_parallel_stitching == false || _threads <= 1) {
+    for (auto& f : _lsFeatures)
+      this->stitch_feature(f, _nc);
+    return;
+  }
+  //-- stitching a feature changes the elevations of its adjacent features, and reads the ones
+  //-- of the features adjacent to them. Features at distance > 2 in the adjacency graph are
+  //-- independent: the graph is coloured (greedily, in the order of the features) so that
+  //-- they get different colours, and the features of a colour are stitched in parallel.
+  std::size_t n = _lsFeatures.size();
+  std::unordered_map<TopoFeature*, std::size_t> ids;
+  for (std::size_t i = 0; i < n; i++)
+    ids[_lsFeatures[i]] = i;
+  std::vector<int> colours(n, -1);
+  std::vector<std::size_t> forbidden;  //-- forbidden[c] == i + 1: c is used near feature i
+  int ncolours = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    for (auto& fadj : *(_lsFeatures[i]->get_adjacent_features())) {
+      int c = colours[ids[fadj]];
+      if (c >= 0)
+        forbidden[c] = i + 1;
+      for (auto& fadj2 : *(fadj->get_adjacent_features())) {
+        c = colours[ids[fadj2]];
+        if (c >= 0)
+          forbidden[c] = i + 1;
+      }
+    }
+    int c = 0;
+    while (c < ncolours && forbidden[c] == i + 1)
+      c++;
+    if (c == ncolours) {
+      ncolours++;
+      forbidden.push_back(0);
+    }
+    colours[i] = c;
+  }
+  std::vector< std::vector<std::size_t> > sets(ncolours);
+  for (std::size_t i = 0; i < n; i++)
+    sets[colours[i]].push_back(i);
+  std::clog << "Stitching " << ncolours << " independent sets of features" << std::endl;
+
+  //-- each thread has its own node columns, they are sorted afterwards so the order does not matter
+  std::vector< CoordMap< std::vector<int> > > ncs(_threads);
+  for (auto& set : sets) {
+    parallel_for_indexed(set.size(), _threads, [this, &set, &ncs](std::size_t i, int t) {
+      this->stitch_feature(_lsFeatures[set[i]], ncs[t]);
+    });
+  }
+  for (auto& nc : ncs) {
+    nc.for_each([this](const CoordKey& key, std::vector<int>& zs) {
+      std::vector<int>& dst = _nc[key];
+      dst.insert(dst.end(), zs.begin(), zs.end());
+    });
+  }
+}
+
+void Map3d::stitch_feature(TopoFeature* f, CoordMap< std::vector<int> > &nc) {
+  //-- the star of a vertex is found in the vertex index instead of scanning the rings of the adjacent features
+  std::vector<VertexIncidence> incidences;
+  //-- 1. store all touching top level (adjacent + incident)
+  std::vector<TopoFeature*>* lstouching = f->get_adjacent_features();
+
+  //-- 2. build the node-column for each vertex
+  // oring
+  Ring2 oring = bg::exterior_ring(*(f->get_Polygon2()));
+  for (int i = 0; i < oring.size(); i++) {
+    // std::cout << std::setprecision(3) << std::fixed << bg::get<0>(oring[i]) << " : " << bg::get<1>(oring[i]) << std::endl;
+    std::vector< std::tuple<TopoFeature*, int, int> > star;
+    bool toprocess = false;
+    _vertexindex.get_incidences(oring[i], incidences);
+    for (auto& fadj : *lstouching) {
+      for (auto& inc : incidences) {
+        if (inc.f == fadj) {
+          //if (f->get_counter() < fadj->get_counter()) {  //-- here that only lowID-->highID are processed
+          toprocess = true;
+          star.push_back(std::make_tuple(fadj, inc.ringi, inc.pi));
+          //}
+        }
+      }
+    }
+    if (toprocess == true) {
+      this->stitch_one_vertex(f, 0, i, star, nc);
+    }
+    else {
+      if (f->get_class() == BUILDING) {
+        f->add_vertical_wall();
+        Point2 tmp = f->get_point2(0, i);
+        CoordKey key_bucket = gen_key_bucket(&tmp);
+        int z = f->get_vertex_elevation(0, i);
+        nc[key_bucket].push_back(z);
+        z = dynamic_cast<Building*>(f)->get_height_base();
+        nc[key_bucket].push_back(z);
+      }
+    }
+  }
+  // irings
+  int noiring = 0;
+  for (Ring2& iring : bg::interior_rings(*(f->get_Polygon2()))) {
+    noiring++;
+    //std::clog << f->get_id() << " irings " << std::endl;
+    for (int i = 0; i < iring.size(); i++) {
       std::vector< std::tuple<TopoFeature*, int, int> > star;
       bool toprocess = false;
+      _vertexindex.get_incidences(iring[i], incidences);
       for (auto& fadj : *lstouching) {
-        ringis.clear();
-        pis.clear();
-        if (fadj->has_point2_(oring[i], ringis, pis) == true) {
-          //if (f->get_counter() < fadj->get_counter()) {  //-- here that only lowID-->highID are processed
-          for (int k = 0; k < ringis.size(); k++) {
-            toprocess = true;
-            star.push_back(std::make_tuple(fadj, ringis[k], pis[k]));
+        bool touching = false;
+        for (auto& inc : incidences) {
+          if (inc.f == fadj) {
+            touching = true;
+            break;
+          }
+        }
+        if (touching == true) {
+          if (f->get_counter() < fadj->get_counter()) {  //-- here that only lowID-->highID are processed
+            for (auto& inc : incidences) {
+              if (inc.f == fadj) {
+                toprocess = true;
+                star.push_back(std::make_tuple(fadj, inc.ringi, inc.pi));
+              }
+            }
+          }
+          else {
+            break;
           }
-          //}
-          //else {
-          //  break;
-          //}
         }
       }
       if (toprocess == true) {
-        this->stitch_one_vertex(f, 0, i, star);
+        this->stitch_one_vertex(f, noiring, i, star, nc);
       }
       else {
         if (f->get_class() == BUILDING) {
           f->add_vertical_wall();
           Point2 tmp = f->get_point2(0, i);
-          std::string key_bucket = gen_key_bucket(&tmp);
+          CoordKey key_bucket = gen_key_bucket(&tmp);
           int z = f->get_vertex_elevation(0, i);
-          _nc[key_bucket].push_back(z);
+          nc[key_bucket].push_back(z);
           z = dynamic_cast<Building*>(f)->get_height_base();
-          _nc[key_bucket].push_back(z);
-        }
-      }
-    }
-    // irings
-    int noiring = 0;
-    for (Ring2& iring : bg::interior_rings(*(f->get_Polygon2()))) {
-      noiring++;
-      //std::clog << f->get_id() << " irings " << std::endl;
-      for (int i = 0; i < iring.size(); i++) {
-        std::vector< std::tuple<TopoFeature*, int, int> > star;
-        bool toprocess = false;
-        for (auto& fadj : *lstouching) {
-          ringis.clear();
-          pis.clear();
-          if (fadj->has_point2_(iring[i], ringis, pis) == true) {
-            if (f->get_counter() < fadj->get_counter()) {  //-- here that only lowID-->highID are processed
-              for (int k = 0; k < ringis.size(); k++) {
-                toprocess = true;
-                star.push_back(std::make_tuple(fadj, ringis[k], pis[k]));
-              }
-            }
-            else {
-              break;
-            }
-          }
-        }
-        if (toprocess == true) {
-          this->stitch_one_vertex(f, noiring, i, star);
-        }
-        else {
-          if (f->get_class() == BUILDING) {
-            f->add_vertical_wall();
-            Point2 tmp = f->get_point2(0, i);
-            std::string key_bucket = gen_key_bucket(&tmp);
-            int z = f->get_vertex_elevation(0, i);
-            _nc[key_bucket].push_back(z);
-            z = dynamic_cast<Building*>(f)->get_height_base();
-            _nc[key_bucket].push_back(z);
-          }
+          nc[key_bucket].push_back(z);
         }
       }
     }
   }
 }
 
-void Map3d::stitch_one_vertex(TopoFeature* f, int ringi, int pi, std::vector< std::tuple<TopoFeature*, int, int> >& star) {
+void Map3d::stitch_one_vertex(TopoFeature* f, int ringi, int pi, std::vector< std::tuple<TopoFeature*, int, int> >& star, CoordMap< std::vector<int> > &nc) {
   //-- degree of vertex == 2
   if (star.size() == 1) {
     TopoFeature* fadj = std::get<0>(star[0]);
     //-- if not building and same class or both soft, then average.
     if (f->get_class() != BUILDING && (f->get_class() == fadj->get_class() || (f->is_hard() == false && fadj->is_hard() == false))) {
-      stitch_average(f, ringi, pi, fadj, std::get<1>(star[0]), std::get<2>(star[0]));
+      stitch_average(f, ringi, pi, fadj, std::get<1>(star[0]), std::get<2>(star[0]), nc);
     }
     else {
-      stitch_jumpedge(f, ringi, pi, fadj, std::get<1>(star[0]), std::get<2>(star[0]));
+      stitch_jumpedge(f, ringi, pi, fadj, std::get<1>(star[0]), std::get<2>(star[0]), nc);
     }
   }
   //-- degree of vertex >= 3: more complex cases
@@ -978,16 +2338,16 @@ void Map3d::stitch_one_vertex(TopoFeature* f, int ringi, int pi, std::vector< st
       std::get<1>(each)->set_vertex_elevation(std::get<2>(each), std::get<3>(each), std::get<0>(each));
       if (std::get<0>(each) != tmph) { //-- not to repeat the same height
         Point2 p = std::get<1>(each)->get_point2(std::get<2>(each), std::get<3>(each));
-        _nc[gen_key_bucket(&p)].push_back(std::get<0>(each));
+        nc[gen_key_bucket(&p)].push_back(std::get<0>(each));
         tmph = std::get<0>(each);
       }
     }
   }
 }
 
-void Map3d::stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2) {
+void Map3d::stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2, CoordMap< std::vector<int> > &nc) {
   Point2 p = f1->get_point2(ringi1, pi1);
-  std::string key_bucket = gen_key_bucket(&p);
+  CoordKey key_bucket = gen_key_bucket(&p);
   int f1z = f1->get_vertex_elevation(ringi1, pi1);
   int f2z = f2->get_vertex_elevation(ringi2, pi2);
 
@@ -1001,13 +2361,13 @@ void Map3d::stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f
       else if (f2z > f1z) {
         f2->add_vertical_wall();
       }
-      _nc[key_bucket].push_back(f1z);
-      _nc[key_bucket].push_back(f2z);
+      nc[key_bucket].push_back(f1z);
+      nc[key_bucket].push_back(f2z);
       int f1base = dynamic_cast<Building*>(f1)->get_height_base();
       int f2base = dynamic_cast<Building*>(f2)->get_height_base();
-      _nc[key_bucket].push_back(f1base);
+      nc[key_bucket].push_back(f1base);
       if (f1base != f2base) {
-        _nc[key_bucket].push_back(f2base);
+        nc[key_bucket].push_back(f2base);
       }
     }
     else if (f1->get_class() == BUILDING) {
@@ -1016,12 +2376,12 @@ void Map3d::stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f
       }
       else {
         //- keep water flat, add the water height to the nc
-        _nc[key_bucket].push_back(f2z);
+        nc[key_bucket].push_back(f2z);
       }
       //- expect a building to always be heighest adjacent feature
       f1->add_vertical_wall();
-      _nc[key_bucket].push_back(f1z);
-      _nc[key_bucket].push_back(dynamic_cast<Building*>(f1)->get_height_base());
+      nc[key_bucket].push_back(f1z);
+      nc[key_bucket].push_back(dynamic_cast<Building*>(f1)->get_height_base());
     }
     else { //-- f2 is Building
       if (f1->get_class() != WATER) {
@@ -1029,12 +2389,12 @@ void Map3d::stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f
       }
       else {
         //- keep water flat, add the water height to the nc
-        _nc[key_bucket].push_back(f1z);
+        nc[key_bucket].push_back(f1z);
       }
       //- expect a building to always be heighest adjacent feature
       f2->add_vertical_wall();
-      _nc[key_bucket].push_back(f2z);
-      _nc[key_bucket].push_back(dynamic_cast<Building*>(f2)->get_height_base());
+      nc[key_bucket].push_back(f2z);
+      nc[key_bucket].push_back(dynamic_cast<Building*>(f2)->get_height_base());
     }
   }
   //-- no Buildings involved
@@ -1060,16 +2420,16 @@ void Map3d::stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f
       else if (f2z > f1z) {
         f2->add_vertical_wall();
       }
-      _nc[key_bucket].push_back(f1z);
-      _nc[key_bucket].push_back(f2z);
+      nc[key_bucket].push_back(f1z);
+      nc[key_bucket].push_back(f2z);
     }
   }
 }
 
-void Map3d::stitch_average(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2) {
+void Map3d::stitch_average(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2, CoordMap< std::vector<int> > &nc) {
   float avgz = (f1->get_vertex_elevation(ringi1, pi1) + f2->get_vertex_elevation(ringi2, pi2)) / 2;
   f1->set_vertex_elevation(ringi1, pi1, avgz);
   f2->set_vertex_elevation(ringi2, pi2, avgz);
   Point2 p = f1->get_point2(ringi1, pi1);
-  _nc[gen_key_bucket(&p)].push_back(avgz);
+  nc[gen_key_bucket(&p)].push_back(avgz);
 }
@@ -39,24 +39,68 @@
 #include "Road.h"
 #include "Separation.h"
 #include "Bridge.h"
+#include "FeatureGrid.h"
+#include "PointCache.h"
+#include "threadtools.h"
+#include <functional>
 
 typedef std::pair<Box2, TopoFeature*> PairIndexed;
 
+//-- consecutive points of a LAS/LAZ file that are decoded as one task
+typedef struct PointInterval {
+  std::size_t fileid;
+  uint32_t    start;
+  uint32_t    count;
+  uint32_t    step;      //-- size of the intervals of the file
+  uint32_t    total;     //-- # of points in the file
+  Box2        bounds;    //-- bounds of the points, from the index or once read
+  bool        hasbounds;
+  bool        complete;  //-- all the points were read
+  bool        fromcache; //-- read from the point cache instead of the file
+} PointInterval;
+
+//-- in tiled mode, the elevations at a vertex on the border between the features written
+//-- by a tile and those written by later tiles, as decided by the first tile
+typedef struct DecidedHeights {
+  std::vector< std::pair<std::string, int> > z;   //-- the elevation of each feature (id) at the vertex
+  std::vector<int>                           nc;  //-- the node column, for the vertical walls
+  std::size_t                                tile; //-- the tile that decided them
+} DecidedHeights;
+
+#define POINT_BLOCK_SIZE     10000    //-- # of LiDAR points decoded per block before routing
+#define POINT_INTERVAL_SIZE  1000000  //-- # of LiDAR points of a file decoded as one task
+#define NUM_FEATURE_LOCKS    4096     //-- # of locks striped over the features
+#define ROUTING_CELL_SIZE    10.0     //-- size (in m) of the cells used to route a block of points
+#define DEMAND_ANY_RETURN    1        //-- a feature class uses the points of this LAS class
+#define DEMAND_LAST_RETURN   2        //-- a feature class uses the last returns of this LAS class
+#define OUTPUT_BATCH_SIZE    256      //-- # of features written to a string by a thread as one task
+
+//-- the demand is indexed by the class in the LAS file (see Map3d::set_point_demand())
+inline bool is_point_demanded(const unsigned char demand[256], int rawclass, bool lastreturn) {
+  return (demand[rawclass & 0xFF] & (lastreturn ? (DEMAND_ANY_RETURN | DEMAND_LAST_RETURN) : DEMAND_ANY_RETURN)) != 0;
+}
+
 class Map3d {
 public:
   Map3d();
   ~Map3d();
 
   bool add_polygons_files(std::vector<PolygonFile> &files);
-  bool add_las_file(std::string ifile, std::vector<int> lasomits, int skip = 0);
+  bool add_las_files(std::vector<PointFile> &files);
 
   void stitch_lifted_features();
   bool construct_rtree();
   bool threeDfy(bool stitching = true);
   bool construct_CDT();
   void add_elevation_point(liblas::Point const& laspt);
+  void add_elevation_point(LidarPoint const& pt);
+  void add_elevation_points(std::vector<LidarPoint> &block);
 
   unsigned long get_num_polygons();
+  bool get_polygons_extent(std::vector<PolygonFile> &files, Box2 &extent);
+  void set_output_tile(const Box2 &tile, const Box2 &extent, bool first, bool last);
+  void save_decided_heights(std::size_t tile, std::size_t tilesperrow);
+  void clear_features();
   const std::vector<TopoFeature*>&  get_polygons3d();
   Box2 get_bbox();
   liblas::Bounds<double> get_bounds();
@@ -66,6 +110,10 @@ public:
   void get_csv_buildings(std::ofstream &outputfile);
   void get_obj_per_feature(std::ofstream &outputfile, int z_exaggeration = 0);
   void get_obj_per_class(std::ofstream &outputfile, int z_exaggeration = 0);
+  bool get_ply(std::ofstream &outputfile);
+  void get_cityjson(std::ofstream &outputfile);
+  bool get_stl(std::ofstream &outputfile);
+  bool get_3dtiles(std::ofstream &outputfile, std::string filename, double tilesize, int epsg);
   bool get_shapefile(std::string filename);
   bool get_shapefile2d(std::string filename);
 
@@ -88,6 +136,15 @@ public:
   void set_threshold_jump_edges(float threshold);
   void set_use_vertical_walls(bool useverticalwalls);
   void set_requested_extent(double xmin, double ymin, double xmax, double ymax);
+  void set_threads(int threads);
+  void set_max_concurrent_files(int files);
+  void set_use_feature_grid(bool usegrid);
+  void set_use_las_index(bool useindex);
+  void set_las_index_dir(std::string dir);
+  void set_point_cache(std::string dir);
+  void set_elevation_accumulator(bool histogram, int bins);
+  void set_use_shared_nodes(bool usenodes);
+  void set_parallel_stitching(bool parallel);
 private:
   float       _building_heightref_roof;
   float       _building_heightref_floor;
@@ -109,11 +166,31 @@ private:
   int         _threshold_jump_edges; //-- in cm/integer
   Box2        _bbox;
   Box2        _requestedExtent;
-
-  std::unordered_map< std::string, std::vector<int> > _nc;
+  bool        _tiled;       //-- only the features with their centre in _tile are written
+  Box2        _tile;
+  Box2        _tileextent;  //-- extent of all the tiles, for the header of the output
+  bool        _tilefirst;
+  bool        _tilelast;
+  int         _threads;
+  int         _max_concurrent_files;
+  bool        _use_feature_grid;
+  bool        _use_las_index;
+  std::string _las_index_dir;
+  std::string _point_cache;
+  unsigned char _pointdemand[256];
+  bool        _use_shared_nodes;
+  bool        _parallel_stitching;
+
+  CoordMap< std::vector<int> >                        _nc;
   std::vector<TopoFeature*>                           _lsFeatures;
   std::vector<std::string>                            _allowed_layers;
   bgi::rtree< PairIndexed, bgi::rstar<16> >           _rtree;
+  FeatureGrid                                         _grid;
+  NodeTable                                           _nodes;
+  VertexIndex                                         _vertexindex;
+  CoordMap<DecidedHeights>                            _decidedheights;  //-- kept from tile to tile
+  std::mutex                                          _featurelocks[NUM_FEATURE_LOCKS];
+  std::mutex                                          _logmutex;
 
 #if GDAL_VERSION_MAJOR < 2
   bool extract_and_add_polygon(OGRDataSource* dataSource, PolygonFile* file);
@@ -121,10 +198,26 @@ private:
   bool extract_and_add_polygon(GDALDataset* dataSource, PolygonFile* file);
 #endif
   void extract_feature(OGRFeature * f, std::string layerName, const char * idfield, const char * heightfield, std::string layertype, bool multiple_heights);
-  void stitch_one_vertex(TopoFeature* f, int ringi, int pi, std::vector< std::tuple<TopoFeature*, int, int> >& star);
-  void stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2);
-  void stitch_average(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2);
-  void collect_adjacent_features(TopoFeature* f);
+  void stitch_feature(TopoFeature* f, CoordMap< std::vector<int> > &nc);
+  void stitch_one_vertex(TopoFeature* f, int ringi, int pi, std::vector< std::tuple<TopoFeature*, int, int> >& star, CoordMap< std::vector<int> > &nc);
+  void stitch_jumpedge(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2, CoordMap< std::vector<int> > &nc);
+  void stitch_average(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2, CoordMap< std::vector<int> > &nc);
+  void collect_adjacent_features();
+  void apply_decided_heights();
+  bool get_las_intervals(PointFile &file, std::size_t fileid, std::vector<PointInterval> &intervals, bool &needindex, bool readall);
+  void save_las_index(PointFile &file, std::size_t fileid, std::vector<PointInterval> &intervals);
+  bool read_las_interval(PointFile &file, PointInterval &interval, BlockingQueue< std::vector<LidarPoint> > &blocks, PointCacheWriter* cache, bool progressbar);
+  void read_cache_interval(PointFile &file, PointCacheReader &cache, PointInterval &interval, BlockingQueue< std::vector<LidarPoint> > &blocks);
+  LidarPoint get_lidarpoint(liblas::Point const& laspt, uint32_t index);
+  void set_point_demand();
+  void construct_node_table();
+  void get_point_demand(PointFile &file, unsigned char demand[256]);
+  bool is_output_feature(TopoFeature* f);
+  void get_feature_mesh(TopoFeature* f, std::vector<Point3> &vertices, std::vector<Triangle> &triangles);
+  bool write_b3dm(std::string filename, std::vector<TopoFeature*> &features, double cx, double cy, OGRCoordinateTransformation* toecef, double &zmin, double &zmax);
+  void write_features(std::ofstream &outputfile, std::function<void(TopoFeature*, std::string&)> get);
+  void write_features(std::ofstream &outputfile, std::vector<TopoFeature*> &features, std::function<void(TopoFeature*, std::string&)> get, std::function<void(TopoFeature*, std::string&)> number = nullptr);
+  void write_obj(std::ofstream &outputfile, std::vector<TopoFeature*> &features, ObjVertexTable &dPts, bool names);
 };
 
 #endif
@@ -0,0 +1,170 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "NodeTable.h"
+
+NodeTable::NodeTable() {
+  _cellsize = 1.0;
+  _radius = 0.0;
+  _finalised = false;
+}
+
+void NodeTable::clear() {
+  std::vector<Node>().swap(_nodes);
+  std::vector<ZAccumulator>().swap(_accumulators);
+  _keys.clear();
+  _cells.clear();
+  std::vector<int>().swap(_cellnodes);
+  _radius = 0.0;
+  _finalised = false;
+}
+
+//-- returns the id of the node at p, created if needed
+int NodeTable::add_node(const Point2 &p, NodeTag tag) {
+  int64_t x = std::llround(p.x() * 1000);
+  int64_t y = std::llround(p.y() * 1000);
+  uint64_t key = (uint64_t(x) << 32) ^ uint64_t(uint32_t(y));
+  //-- keys of far away coordinates can collide, then the next key is tried
+  auto it = _keys.find(key);
+  while (it != _keys.end()) {
+    Node &n = _nodes[it->second];
+    if (std::llround(n.p.x() * 1000) == x && std::llround(n.p.y() * 1000) == y) {
+      n.tags |= (unsigned char)(1 << tag);
+      return it->second;
+    }
+    it = _keys.find(++key);
+  }
+  Node n;
+  n.p = p;
+  n.tags = (unsigned char)(1 << tag);
+  n.first = 0;
+  _nodes.push_back(n);
+  _keys[key] = int(_nodes.size() - 1);
+  return int(_nodes.size() - 1);
+}
+
+//-- allocates the accumulators and builds the grid of cells (of size radius) over the nodes
+void NodeTable::finalise(float radius) {
+  _radius = radius;
+  _cellsize = std::max(double(radius), 0.01);
+  int count = 0;
+  for (auto& n : _nodes) {
+    n.first = count;
+    for (int t = 0; t < NUM_NODE_TAGS; t++) {
+      if (n.tags & (1 << t))
+        count++;
+    }
+  }
+  _accumulators.resize(count);
+  std::unordered_map<uint64_t, int>().swap(_keys);
+
+  std::vector< std::pair<uint64_t, int> > cellnodes(_nodes.size());
+  for (std::size_t i = 0; i < _nodes.size(); i++)
+    cellnodes[i] = std::make_pair(get_cell_key(_nodes[i].p.x(), _nodes[i].p.y()), int(i));
+  std::sort(cellnodes.begin(), cellnodes.end());
+  _cellnodes.resize(cellnodes.size());
+  for (std::size_t i = 0; i < cellnodes.size(); i++) {
+    _cellnodes[i] = cellnodes[i].second;
+    if (i == 0 || cellnodes[i].first != cellnodes[i - 1].first)
+      _cells[cellnodes[i].first] = std::make_pair(int(i), int(i + 1));
+    else
+      _cells[cellnodes[i].first].second = int(i + 1);
+  }
+  _finalised = true;
+}
+
+bool NodeTable::is_finalised() const {
+  return _finalised;
+}
+
+std::size_t NodeTable::get_num_nodes() const {
+  return _nodes.size();
+}
+
+//-- thread-safe: the accumulators of a node are only modified while holding the lock of its stripe
+void NodeTable::add_elevation_point(const LidarPoint &pt) {
+  if (pt.lastreturn == false)
+    return;
+  unsigned char tags = 0;
+  if (pt.lasclass == LAS_GROUND)
+    tags |= (1 << NODE_GROUND_LAST);
+  if (pt.lasclass != LAS_BUILDING)
+    tags |= (1 << NODE_NOT_BUILDING_LAST);
+  if (pt.lasclass != LAS_BUILDING && pt.lasclass != LAS_WATER)
+    tags |= (1 << NODE_NOT_BUILDING_NOT_WATER_LAST);
+  int zcm = int(pt.z * 100);
+  double sqradius = double(_radius) * _radius;
+  Point2 p(pt.x, pt.y);
+  int64_t cx = int64_t(std::floor(pt.x / _cellsize));
+  int64_t cy = int64_t(std::floor(pt.y / _cellsize));
+  for (int64_t i = cx - 1; i <= cx + 1; i++) {
+    for (int64_t j = cy - 1; j <= cy + 1; j++) {
+      auto it = _cells.find((uint64_t(i) << 32) ^ uint64_t(uint32_t(j)));
+      if (it == _cells.end())
+        continue;
+      for (int k = it->second.first; k < it->second.second; k++) {
+        int ni = _cellnodes[k];
+        Node &n = _nodes[ni];
+        if ((n.tags & tags) == 0 || bg::comparable_distance(p, n.p) > sqradius)
+          continue;
+        std::lock_guard<std::mutex> lock(_locks[ni % NUM_NODE_LOCKS]);
+        for (int t = 0; t < NUM_NODE_TAGS; t++) {
+          if (n.tags & tags & (1 << t))
+            _accumulators[get_accumulator(n, NodeTag(t))].add(zcm);
+        }
+      }
+    }
+  }
+}
+
+//-- -9999 if no point was added to the node for this tag
+int NodeTable::get_percentile(int node, NodeTag tag, float percentile) {
+  Node &n = _nodes[node];
+  if ((n.tags & (1 << tag)) == 0)
+    return -9999;
+  std::lock_guard<std::mutex> lock(_locks[node % NUM_NODE_LOCKS]);
+  ZAccumulator &a = _accumulators[get_accumulator(n, tag)];
+  if (a.empty())
+    return -9999;
+  return a.get_percentile(percentile);
+}
+
+uint64_t NodeTable::get_cell_key(double x, double y) const {
+  int64_t cx = int64_t(std::floor(x / _cellsize));
+  int64_t cy = int64_t(std::floor(y / _cellsize));
+  return (uint64_t(cx) << 32) ^ uint64_t(uint32_t(cy));
+}
+
+int NodeTable::get_accumulator(const Node &n, NodeTag tag) const {
+  int index = n.first;
+  for (int t = 0; t < tag; t++) {
+    if (n.tags & (1 << t))
+      index++;
+  }
+  return index;
+}
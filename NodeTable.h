@@ -0,0 +1,81 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef NodeTable_h
+#define NodeTable_h
+
+#include "definitions.h"
+#include "ZAccumulator.h"
+#include <mutex>
+
+#define NUM_NODE_LOCKS 4096 //-- # of locks striped over the nodes
+
+//-- which LiDAR points a feature samples at its vertices (see add_elevation_point() of each class)
+typedef enum {
+  NODE_GROUND_LAST                 = 0, //-- Terrain, Road, Forest with ground points only
+  NODE_NOT_BUILDING_LAST           = 1, //-- Forest
+  NODE_NOT_BUILDING_NOT_WATER_LAST = 2, //-- Separation
+  NUM_NODE_TAGS                    = 3
+} NodeTag;
+
+//-- the unique 2D vertices (snapped to the mm) of the features that sample the LiDAR points
+//-- at their vertices. A point is added once to a node, for each tag the features using the
+//-- node need, instead of once to each of those features.
+class NodeTable {
+public:
+  NodeTable();
+
+  int  add_node(const Point2 &p, NodeTag tag);
+  void finalise(float radius);
+  void clear();
+  bool is_finalised() const;
+  std::size_t get_num_nodes() const;
+  void add_elevation_point(const LidarPoint &pt);
+  int  get_percentile(int node, NodeTag tag, float percentile);
+private:
+  typedef struct Node {
+    Point2        p;
+    unsigned char tags;  //-- bitmask of the NodeTag used
+    int           first; //-- index of the accumulator of the first tag used
+  } Node;
+
+  std::vector<Node>                         _nodes;
+  std::vector<ZAccumulator>                 _accumulators;
+  std::unordered_map<uint64_t, int>         _keys;
+  std::unordered_map<uint64_t, std::pair<int, int> > _cells; //-- range in _cellnodes
+  std::vector<int>                          _cellnodes;
+  double                                    _cellsize;
+  float                                     _radius;
+  bool                                      _finalised;
+  std::mutex                                _locks[NUM_NODE_LOCKS];
+
+  uint64_t get_cell_key(double x, double y) const;
+  int      get_accumulator(const Node &n, NodeTag tag) const;
+};
+
+#endif /* NodeTable_h */
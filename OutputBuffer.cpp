@@ -0,0 +1,149 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "OutputBuffer.h"
+#include <cmath>
+#include <cstdio>
+
+OutputBuffer& OutputBuffer::operator<<(const std::string& s) {
+  _buf += s;
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char* s) {
+  _buf += s;
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(char c) {
+  _buf += c;
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(int v) {
+  append_signed(v);
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(unsigned int v) {
+  append_unsigned(v);
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(long v) {
+  append_signed(v);
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(unsigned long v) {
+  append_unsigned(v);
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(long long v) {
+  append_signed(v);
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(unsigned long long v) {
+  append_unsigned(v);
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(float v) {
+  return (*this << double(v));
+}
+
+OutputBuffer& OutputBuffer::operator<<(double v) {
+  //-- rounded to mm as printf does: to the nearest, the exact halves to the even mm. v * 1000
+  //-- is rounded itself, fma() gives its error to decide the halves. Beyond 2^52 mm (or not
+  //-- a number) the product is not exact enough, it goes through printf.
+  if (std::isfinite(v) && std::fabs(v) < 4e12) {
+    double p = v * 1000.0;
+    double e = std::fma(v, 1000.0, -p);
+    double mm = std::nearbyint(p);
+    if (p - mm == 0.5 && e > 0)
+      mm += 1;
+    else if (p - mm == -0.5 && e < 0)
+      mm -= 1;
+    append_mm(int64_t(mm));
+  }
+  else {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%.3f", v);
+    _buf += buf;
+  }
+  return *this;
+}
+
+//-- mm as meters with 3 decimals
+void OutputBuffer::append_mm(int64_t mm) {
+  uint64_t v = (mm < 0) ? uint64_t(0) - uint64_t(mm) : uint64_t(mm);
+  if (mm < 0)
+    _buf += '-';
+  append_unsigned(v / 1000);
+  unsigned int frac = unsigned(v % 1000);
+  char d[4] = { '.', char('0' + frac / 100), char('0' + (frac / 10) % 10), char('0' + frac % 10) };
+  _buf.append(d, 4);
+}
+
+void OutputBuffer::write(std::ostream& out) const {
+  out.write(_buf.data(), _buf.size());
+}
+
+const std::string& OutputBuffer::str() const {
+  return _buf;
+}
+
+std::size_t OutputBuffer::size() const {
+  return _buf.size();
+}
+
+void OutputBuffer::clear() {
+  _buf.clear();
+}
+
+void OutputBuffer::append_unsigned(unsigned long long v) {
+  char d[20];
+  int n = 0;
+  do {
+    d[n++] = char('0' + v % 10);
+    v /= 10;
+  } while (v > 0);
+  while (n > 0)
+    _buf += d[--n];
+}
+
+void OutputBuffer::append_signed(long long v) {
+  if (v < 0) {
+    _buf += '-';
+    append_unsigned(0ULL - (unsigned long long)v);
+  }
+  else
+    append_unsigned((unsigned long long)v);
+}
@@ -0,0 +1,64 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef OutputBuffer_h
+#define OutputBuffer_h
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+//-- text appended to one growing string, for the writers of the output formats. The
+//-- numbers are formatted by hand: integers as they are, floating-point numbers with
+//-- 3 decimals (as std::fixed with std::setprecision(3)), without any locale or iostream.
+class OutputBuffer {
+public:
+  OutputBuffer& operator<<(const std::string& s);
+  OutputBuffer& operator<<(const char* s);
+  OutputBuffer& operator<<(char c);
+  OutputBuffer& operator<<(int v);
+  OutputBuffer& operator<<(unsigned int v);
+  OutputBuffer& operator<<(long v);
+  OutputBuffer& operator<<(unsigned long v);
+  OutputBuffer& operator<<(long long v);
+  OutputBuffer& operator<<(unsigned long long v);
+  OutputBuffer& operator<<(float v);
+  OutputBuffer& operator<<(double v);
+
+  void               append_mm(int64_t mm);
+  void               write(std::ostream& out) const;
+  const std::string& str() const;
+  std::size_t        size() const;
+  void               clear();
+private:
+  std::string _buf;
+  void        append_unsigned(unsigned long long v);
+  void        append_signed(long long v);
+};
+
+#endif /* OutputBuffer_h */
@@ -0,0 +1,262 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "PointCache.h"
+#include "geomtools.h"
+#include "io.h"
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+#include <boost/filesystem/operations.hpp>
+
+//-- unsorted records written while reading: x, y, z as double, the index and the class byte
+#define POINT_CACHE_UNSORTED_RECORD_SIZE 29
+
+//-- the cache only depends on the file itself (path, size and modification time)
+std::string get_point_cache_key(PointFile &file) {
+  std::stringstream ss;
+  ss << boost::filesystem::absolute(file.filename).string();
+  ss << "|" << boost::filesystem::file_size(file.filename);
+  ss << "|" << boost::filesystem::last_write_time(file.filename);
+  return ss.str();
+}
+
+std::string get_point_cache_filename(std::string dir, std::string key) {
+  std::stringstream ss;
+  ss << std::hex << std::hash<std::string>()(key);
+  return (boost::filesystem::path(dir) / (ss.str() + ".3dfpc")).string();
+}
+
+PointCacheWriter::PointCacheWriter() {
+  _count = 0;
+}
+
+PointCacheWriter::~PointCacheWriter() {
+  if (_ofs.is_open())
+    this->discard();
+}
+
+//-- the points are written unsorted to <filename>.unsorted; close() sorts them in
+//-- <filename>.tmp, which is renamed once complete
+bool PointCacheWriter::open(std::string filename, std::string key) {
+  _filename = filename;
+  _key = key;
+  _count = 0;
+  for (int i = 0; i < 3; i++)
+    _min[i] = std::numeric_limits<double>::max();
+  _ofs.open((_filename + ".unsorted").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  return _ofs.is_open();
+}
+
+//-- thread-safe
+void PointCacheWriter::add_points(std::vector<LidarPoint> const& pts) {
+  std::vector<char> buffer(pts.size() * POINT_CACHE_UNSORTED_RECORD_SIZE);
+  char* r = buffer.data();
+  double ptsmin[3] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+  for (auto& pt : pts) {
+    double c[3] = { pt.x, pt.y, pt.z };
+    for (int i = 0; i < 3; i++)
+      ptsmin[i] = std::min(ptsmin[i], c[i]);
+    uint8_t cl = uint8_t(pt.rawclass & 0x7F);
+    if (pt.lastreturn)
+      cl |= 0x80;
+    std::memcpy(r, c, 24);
+    std::memcpy(r + 24, &pt.index, 4);
+    r[28] = char(cl);
+    r += POINT_CACHE_UNSORTED_RECORD_SIZE;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _ofs.write(buffer.data(), buffer.size());
+  for (int i = 0; i < 3; i++)
+    _min[i] = std::min(_min[i], ptsmin[i]);
+  _count += pts.size();
+}
+
+bool PointCacheWriter::close() {
+  _ofs.close();
+  bool wentgood = bool(_ofs) && this->write_sorted();
+  boost::system::error_code ec;
+  boost::filesystem::remove(_filename + ".unsorted", ec);
+  if (wentgood == false) {
+    boost::filesystem::remove(_filename + ".tmp", ec);
+    return false;
+  }
+  boost::filesystem::rename(_filename + ".tmp", _filename, ec);
+  return !ec;
+}
+
+void PointCacheWriter::discard() {
+  if (_ofs.is_open())
+    _ofs.close();
+  boost::system::error_code ec;
+  boost::filesystem::remove(_filename + ".unsorted", ec);
+  boost::filesystem::remove(_filename + ".tmp", ec);
+}
+
+//-- sorts all the points of the file along a Morton curve (1m cells); only the codes are in
+//-- memory (16 bytes per point), the points are read from the mapped unsorted file
+bool PointCacheWriter::write_sorted() {
+  if (_count == 0) {
+    for (int i = 0; i < 3; i++)
+      _min[i] = 0.0;
+  }
+  const char* unsorted = NULL;
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+  if (_count > 0) {
+    try {
+      file = boost::interprocess::file_mapping((_filename + ".unsorted").c_str(), boost::interprocess::read_only);
+      region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+    }
+    catch (boost::interprocess::interprocess_exception &e) {
+      return false;
+    }
+    if (region.get_size() != _count * POINT_CACHE_UNSORTED_RECORD_SIZE)
+      return false;
+    unsorted = static_cast<const char*>(region.get_address());
+  }
+  std::vector< std::pair<uint64_t, uint64_t> > codes(_count);
+  for (uint64_t i = 0; i < _count; i++) {
+    double c[2];
+    std::memcpy(c, unsorted + (i * POINT_CACHE_UNSORTED_RECORD_SIZE), 16);
+    codes[i] = std::make_pair(morton_code(uint32_t(c[0] - _min[0]), uint32_t(c[1] - _min[1])), i);
+  }
+  std::sort(codes.begin(), codes.end());
+
+  std::ofstream ofs((_filename + ".tmp").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (ofs.is_open() == false)
+    return false;
+  uint64_t nblocks = (_count + POINT_CACHE_BLOCK_SIZE - 1) / POINT_CACHE_BLOCK_SIZE;
+  uint32_t keylength = uint32_t(_key.size());
+  ofs.write(POINT_CACHE_MAGIC, 8);
+  ofs.write((char*)&keylength, sizeof(keylength));
+  ofs.write(_key.c_str(), keylength);
+  ofs.write((char*)_min, sizeof(_min));
+  ofs.write((char*)&_count, sizeof(_count));
+  ofs.write((char*)&nblocks, sizeof(nblocks));
+  std::vector<double> blockbounds;
+  std::vector<char> buffer;
+  for (uint64_t b = 0; b < nblocks; b++) {
+    uint64_t end = std::min(_count, (b + 1) * POINT_CACHE_BLOCK_SIZE);
+    double bounds[4] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() };
+    buffer.resize((end - b * POINT_CACHE_BLOCK_SIZE) * POINT_CACHE_RECORD_SIZE);
+    char* r = buffer.data();
+    for (uint64_t i = b * POINT_CACHE_BLOCK_SIZE; i < end; i++) {
+      const char* u = unsorted + (codes[i].second * POINT_CACHE_UNSORTED_RECORD_SIZE);
+      double c[3];
+      std::memcpy(c, u, 24);
+      bounds[0] = std::min(bounds[0], c[0]);
+      bounds[1] = std::min(bounds[1], c[1]);
+      bounds[2] = std::max(bounds[2], c[0]);
+      bounds[3] = std::max(bounds[3], c[1]);
+      int32_t q[3];
+      for (int j = 0; j < 3; j++)
+        q[j] = int32_t(std::llround((c[j] - _min[j]) / POINT_CACHE_SCALE));
+      std::memcpy(r, q, 12);
+      std::memcpy(r + 12, u + 24, 5);
+      r += POINT_CACHE_RECORD_SIZE;
+    }
+    ofs.write(buffer.data(), buffer.size());
+    blockbounds.insert(blockbounds.end(), bounds, bounds + 4);
+  }
+  ofs.write((char*)blockbounds.data(), blockbounds.size() * sizeof(double));
+  ofs.close();
+  return bool(ofs);
+}
+
+PointCacheReader::PointCacheReader() {
+  _records = NULL;
+  _blockbounds = NULL;
+  _count = 0;
+  _nblocks = 0;
+}
+
+//-- maps the file in memory; false if it does not exist or was made with another key
+bool PointCacheReader::open(std::string filename, std::string key) {
+  if (boost::filesystem::exists(filename) == false)
+    return false;
+  try {
+    _file = boost::interprocess::file_mapping(filename.c_str(), boost::interprocess::read_only);
+    _region = boost::interprocess::mapped_region(_file, boost::interprocess::read_only);
+  }
+  catch (boost::interprocess::interprocess_exception &e) {
+    return false;
+  }
+  const char* data = static_cast<const char*>(_region.get_address());
+  std::size_t size = _region.get_size();
+  if (size < 12 || std::string(data, 8) != POINT_CACHE_MAGIC)
+    return false;
+  uint32_t keylength;
+  std::memcpy(&keylength, data + 8, sizeof(keylength));
+  std::size_t headersize = 12 + keylength + sizeof(_origin) + sizeof(_count) + sizeof(_nblocks);
+  if (size < headersize || std::string(data + 12, keylength) != key)
+    return false;
+  std::memcpy(_origin, data + 12 + keylength, sizeof(_origin));
+  std::memcpy(&_count, data + 12 + keylength + sizeof(_origin), sizeof(_count));
+  std::memcpy(&_nblocks, data + 12 + keylength + sizeof(_origin) + sizeof(_count), sizeof(_nblocks));
+  if (_nblocks != (_count + POINT_CACHE_BLOCK_SIZE - 1) / POINT_CACHE_BLOCK_SIZE ||
+    size != headersize + (_count * POINT_CACHE_RECORD_SIZE) + (_nblocks * 4 * sizeof(double)))
+    return false;
+  _records = data + headersize;
+  _blockbounds = _records + (_count * POINT_CACHE_RECORD_SIZE);
+  return true;
+}
+
+uint64_t PointCacheReader::get_num_points() const {
+  return _count;
+}
+
+uint64_t PointCacheReader::get_num_blocks() const {
+  return _nblocks;
+}
+
+Box2 PointCacheReader::get_block_bounds(uint64_t block) const {
+  double b[4];
+  std::memcpy(b, _blockbounds + (block * 4 * sizeof(double)), sizeof(b));
+  return Box2(Point2(b[0], b[1]), Point2(b[2], b[3]));
+}
+
+//-- thread-safe: the mapped file is only read
+void PointCacheReader::get_points(uint64_t start, uint64_t count, std::vector<LidarPoint> &pts) const {
+  pts.resize(count);
+  const char* r = _records + (start * POINT_CACHE_RECORD_SIZE);
+  for (uint64_t i = 0; i < count; i++) {
+    int32_t q[3];
+    std::memcpy(q, r, 12);
+    uint8_t c = uint8_t(r[16]);
+    std::memcpy(&pts[i].index, r + 12, 4);
+    pts[i].x = _origin[0] + (q[0] * POINT_CACHE_SCALE);
+    pts[i].y = _origin[1] + (q[1] * POINT_CACHE_SCALE);
+    pts[i].z = _origin[2] + (q[2] * POINT_CACHE_SCALE);
+    pts[i].rawclass = (c & 0x7F);
+    pts[i].lasclass = get_las14class(pts[i].rawclass);
+    pts[i].lastreturn = ((c & 0x80) != 0);
+    r += POINT_CACHE_RECORD_SIZE;
+  }
+}
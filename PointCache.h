@@ -0,0 +1,91 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef PointCache_h
+#define PointCache_h
+
+#include "definitions.h"
+#include <mutex>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+//-- cache of the points of a LAS/LAZ file, so that later runs over the same file do not
+//-- have to decode it again, whatever their extent, tiles or filters: all the points of
+//-- the standard classes (0-18) are kept, and the filters are applied when they are read.
+//-- binary file: a header (magic, key, origin, # points, # blocks) followed by records of
+//-- 17 bytes: x, y, z as int32 in mm relative to the origin, the position of the point in
+//-- the LAS file as uint32 (the thinning is on it, as when reading the file), and the LAS
+//-- class with the last-return flag in its highest bit; then the bounds (minx, miny, maxx, maxy)
+//-- of each block of POINT_CACHE_BLOCK_SIZE records. The points of the whole file are in
+//-- Morton order, so that a block covers a small area and those outside the polygons are
+//-- not read.
+#define POINT_CACHE_MAGIC       "3DFPTC03"
+#define POINT_CACHE_RECORD_SIZE 17
+#define POINT_CACHE_SCALE       0.001
+#define POINT_CACHE_BLOCK_SIZE  65536
+
+std::string get_point_cache_key(PointFile &file);
+std::string get_point_cache_filename(std::string dir, std::string key);
+
+class PointCacheWriter {
+public:
+  PointCacheWriter();
+  ~PointCacheWriter();
+  bool open(std::string filename, std::string key);
+  void add_points(std::vector<LidarPoint> const& pts);
+  bool close();
+  void discard();
+private:
+  std::string   _filename;
+  std::string   _key;
+  std::ofstream _ofs;  //-- the points as they are read, sorted by close()
+  double        _min[3];
+  uint64_t      _count;
+  std::mutex    _mutex;
+  bool          write_sorted();
+};
+
+class PointCacheReader {
+public:
+  PointCacheReader();
+  bool     open(std::string filename, std::string key);
+  uint64_t get_num_points() const;
+  uint64_t get_num_blocks() const;
+  Box2     get_block_bounds(uint64_t block) const;
+  void     get_points(uint64_t start, uint64_t count, std::vector<LidarPoint> &pts) const;
+private:
+  boost::interprocess::file_mapping  _file;
+  boost::interprocess::mapped_region _region;
+  const char*                        _records;
+  const char*                        _blockbounds;
+  double                             _origin[3];
+  uint64_t                           _count;
+  uint64_t                           _nblocks;
+};
+
+#endif /* PointCache_h */
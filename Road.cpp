@@ -62,97 +62,99 @@ bool Road::lift() {
 }
 
 std::string Road::get_citygml() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<tran:Road gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<tran:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<tran:Road gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<tran:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</tran:lod1MultiSurface>" << std::endl;
-  ss << "</tran:Road>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</tran:lod1MultiSurface>\n";
+  ss << "</tran:Road>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
+std::string Road::get_cityjson(ObjVertexTable &dPts) {
+  return get_cityjson_object("Road", get_cityjson_multisurface(dPts, "TrafficArea"));
+}
+
 std::string Road::get_citygml_imgeo() {
   bool auxiliary = _layername == "auxiliarytrafficarea";
   bool spoor = _layername == "spoor";
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
   if (spoor) {
-    ss << "<tra:Railway gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<tra:Railway gml:id=\"" << this->get_id() << "\">\n";
   }
   else if (auxiliary) {
-    ss << "<tra:AuxiliaryTrafficArea gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<tra:AuxiliaryTrafficArea gml:id=\"" << this->get_id() << "\">\n";
   }
   else {
-    ss << "<tra:TrafficArea gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<tra:TrafficArea gml:id=\"" << this->get_id() << "\">\n";
   }
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<tra:lod2MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<tra:lod2MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</tra:lod2MultiSurface>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</tra:lod2MultiSurface>\n";
   std::string attribute;
 
   if (spoor) {
     if (get_attribute("bgt-functie", attribute)) {
-      ss << "<tra:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieSpoor\">" << attribute << "</tra:function>" << std::endl;
+      ss << "<tra:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieSpoor\">" << attribute << "</tra:function>\n";
     }
     if (get_attribute("plus-functiespoor", attribute)) {
-      ss << "<imgeo:plus-functieSpoor codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieSpoorPlus\">" << attribute << "</imgeo:plus-functieSpoor>" << std::endl;
+      ss << "<imgeo:plus-functieSpoor codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieSpoorPlus\">" << attribute << "</imgeo:plus-functieSpoor>\n";
     }
-    ss << "</tra:Railway>" << std::endl;
+    ss << "</tra:Railway>\n";
   }
   else if (auxiliary) {
     if (get_attribute("bgt-functie", attribute)) {
-      ss << "<tra:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWegdeel\">" << attribute << "</tra:function>" << std::endl;
+      ss << "<tra:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWegdeel\">" << attribute << "</tra:function>\n";
     }
     if (get_attribute("bgt-fysiekvoorkomen", attribute)) {
-      ss << "<tra:surfaceMaterial codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOndersteunendWegdeel\">" << attribute << "</imgeo:tra:surfaceMaterial>" << std::endl;
+      ss << "<tra:surfaceMaterial codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOndersteunendWegdeel\">" << attribute << "</imgeo:tra:surfaceMaterial>\n";
     }
     if (get_attribute("ondersteunendwegdeeloptalud", attribute, "false")) {
-      ss << "<imgeo:ondersteunendWegdeelOpTalud>" << attribute << "</imgeo:ondersteunendWegdeelOpTalud>" << std::endl;
+      ss << "<imgeo:ondersteunendWegdeelOpTalud>" << attribute << "</imgeo:ondersteunendWegdeelOpTalud>\n";
     }
     if (get_attribute("plus-functieondersteunendwegdeel", attribute)) {
-      ss << "<imgeo:plus-functieOndersteunendWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWegdeelPlus\">" << attribute << "</imgeo:plus-functieOndersteunendWegdeel>" << std::endl;
+      ss << "<imgeo:plus-functieOndersteunendWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWegdeelPlus\">" << attribute << "</imgeo:plus-functieOndersteunendWegdeel>\n";
     }
     if (get_attribute("plus-fysiekvoorkomenondersteunendwegdeel", attribute)) {
-      ss << "<imgeo:plus-fysiekVoorkomenOndersteunendWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOndersteunendWegdeelPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomenOndersteunendWegdeel>" << std::endl;
+      ss << "<imgeo:plus-fysiekVoorkomenOndersteunendWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOndersteunendWegdeelPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomenOndersteunendWegdeel>\n";
     }
-    ss << "</tra:AuxiliaryTrafficArea>" << std::endl;
+    ss << "</tra:AuxiliaryTrafficArea>\n";
   }
   else
   {
     if (get_attribute("bgt-functie", attribute)) {
-      ss << "<tra:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieWeg\">" << attribute << "</tra:function>" << std::endl;
+      ss << "<tra:function codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieWeg\">" << attribute << "</tra:function>\n";
     }
     if (get_attribute("bgt-fysiekvoorkomen", attribute)) {
-      ss << "<tra:surfaceMaterial codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenWeg\">" << attribute << "</tra:surfaceMaterial>" << std::endl;
+      ss << "<tra:surfaceMaterial codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenWeg\">" << attribute << "</tra:surfaceMaterial>\n";
     }
     if (!get_attribute("wegdeeloptalud", attribute, "false")) {
-      ss << "<imgeo:wegdeelOpTalud>" << attribute << "</imgeo:wegdeelOpTalud>" << std::endl;
+      ss << "<imgeo:wegdeelOpTalud>" << attribute << "</imgeo:wegdeelOpTalud>\n";
     }
     if (get_attribute("plus-functiewegdeel", attribute)) {
-      ss << "<imgeo:plus-functieWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieWegPlus\">" << attribute << "</imgeo:plus-functieWegdeel>" << std::endl;
+      ss << "<imgeo:plus-functieWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FunctieWegPlus\">" << attribute << "</imgeo:plus-functieWegdeel>\n";
     }
     if (get_attribute("plus-fysiekvoorkomenwegdeel", attribute)) {
-      ss << "<imgeo:plus-fysiekVoorkomenWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenWegPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomenWegdeel>" << std::endl;
+      ss << "<imgeo:plus-fysiekVoorkomenWegdeel codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenWegPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomenWegdeel>\n";
     }
-    ss << "</tra:TrafficArea>" << std::endl;
+    ss << "</tra:TrafficArea>\n";
   }
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
@@ -64,77 +64,79 @@ bool Separation::lift() {
 }
 
 std::string Separation::get_citygml() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<gen:GenericCityObject gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<gen:lod1Geometry>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<gen:GenericCityObject gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<gen:lod1Geometry>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</gen:lod1Geometry>" << std::endl;
-  ss << "</gen:GenericCityObject>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</gen:lod1Geometry>\n";
+  ss << "</gen:GenericCityObject>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
+std::string Separation::get_cityjson(ObjVertexTable &dPts) {
+  return get_cityjson_object("GenericCityObject", get_cityjson_multisurface(dPts));
+}
+
 std::string Separation::get_citygml_imgeo() {
   bool kunstwerkdeel = _layername == "kunstwerkdeel";
   bool overigbouwwerk = _layername == "overigbouwwerk";
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
   if (kunstwerkdeel) {
-    ss << "<imgeo:Kunstwerkdeel gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<imgeo:Kunstwerkdeel gml:id=\"" << this->get_id() << "\">\n";
   }
   else if (overigbouwwerk) {
-    ss << "<imgeo:OverigBouwwerk gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<imgeo:OverigBouwwerk gml:id=\"" << this->get_id() << "\">\n";
   }
   else {
-    ss << "<imgeo:Scheiding gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<imgeo:Scheiding gml:id=\"" << this->get_id() << "\">\n";
   }
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<imgeo:lod1Geometry>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<imgeo:lod1Geometry>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</imgeo:lod1Geometry>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</imgeo:lod1Geometry>\n";
   std::string attribute;
   if (kunstwerkdeel) {
     if (get_attribute("bgt-type", attribute)) {
-      ss << "<imgeo:bgt-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeKunstwerk\">" << attribute << "</imgeo:bgt-type>" << std::endl;
+      ss << "<imgeo:bgt-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeKunstwerk\">" << attribute << "</imgeo:bgt-type>\n";
     }
     if (get_attribute("plus-type", attribute)) {
-      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeKunstwerkPlus\">" << attribute << "</imgeo:plus-type>" << std::endl;
+      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeKunstwerkPlus\">" << attribute << "</imgeo:plus-type>\n";
     }
-    ss << "</imgeo:Kunstwerkdeel>" << std::endl;
+    ss << "</imgeo:Kunstwerkdeel>\n";
   }
   else if (overigbouwwerk) {
     if (get_attribute("bgt-type", attribute)) {
-      ss << "<imgeo:bgt-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverigBouwwerk\">" << attribute << "</imgeo:bgt-type>" << std::endl;
+      ss << "<imgeo:bgt-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverigBouwwerk\">" << attribute << "</imgeo:bgt-type>\n";
     }
     if (get_attribute("plus-type", attribute)) {
-      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverigBouwwerkPlus\">" << attribute << "</imgeo:plus-type>" << std::endl;
+      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOverigBouwwerkPlus\">" << attribute << "</imgeo:plus-type>\n";
     }
-    ss << "</imgeo:OverigBouwwerk>" << std::endl;
+    ss << "</imgeo:OverigBouwwerk>\n";
   }
   else {
     if (get_attribute("bgt-type", attribute)) {
-      ss << "<imgeo:bgt-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeScheiding\">" << attribute << "</imgeo:bgt-type>" << std::endl;
+      ss << "<imgeo:bgt-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeScheiding\">" << attribute << "</imgeo:bgt-type>\n";
     }
     if (get_attribute("plus-type", attribute)) {
-      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeScheidingPlus\">" << attribute << "</imgeo:plus-type>" << std::endl;
+      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeScheidingPlus\">" << attribute << "</imgeo:plus-type>\n";
     }
-    ss << "</imgeo:Scheiding>" << std::endl;
+    ss << "</imgeo:Scheiding>\n";
   }
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
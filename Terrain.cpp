@@ -60,50 +60,52 @@ bool Terrain::lift() {
 }
 
 std::string Terrain::get_citygml() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<luse:LandUse gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<luse:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<luse:LandUse gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<luse:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</luse:lod1MultiSurface>" << std::endl;
-  ss << "</luse:LandUse>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</luse:lod1MultiSurface>\n";
+  ss << "</luse:LandUse>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
+std::string Terrain::get_cityjson(ObjVertexTable &dPts) {
+  return get_cityjson_object("LandUse", get_cityjson_multisurface(dPts));
+}
+
 std::string Terrain::get_citygml_imgeo() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<imgeo:OnbegroeidTerreindeel gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<lu:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<imgeo:OnbegroeidTerreindeel gml:id=\"" << this->get_id() << "\">\n";
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<lu:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</lu:lod1MultiSurface>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</lu:lod1MultiSurface>\n";
   std::string attribute;
   if (get_attribute("bgt-fysiekvoorkomen", attribute)) {
-    ss << "<imgeo:bgt-fysiekVoorkomen codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOnbegroeidTerrein\">" << attribute /*"erf"*/ << "</imgeo:bgt-fysiekVoorkomen>" << std::endl;
+    ss << "<imgeo:bgt-fysiekVoorkomen codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOnbegroeidTerrein\">" << attribute /*"erf"*/ << "</imgeo:bgt-fysiekVoorkomen>\n";
   }
   if (get_attribute("onbegroeidterreindeeloptalud", attribute, "false")) {
-    ss << "<imgeo:onbegroeidTerreindeelOpTalud>" << attribute << "</imgeo:onbegroeidTerreindeelOpTalud>" << std::endl;
+    ss << "<imgeo:onbegroeidTerreindeelOpTalud>" << attribute << "</imgeo:onbegroeidTerreindeelOpTalud>\n";
   }
   if (get_attribute("plus-fysiekvoorkomen", attribute)) {
-    ss << "<imgeo:plus-fysiekVoorkomen codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOnbegroeidTerreinPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomen>" << std::endl;
+    ss << "<imgeo:plus-fysiekVoorkomen codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#FysiekVoorkomenOnbegroeidTerreinPlus\">" << attribute << "</imgeo:plus-fysiekVoorkomen>\n";
   }
-  ss << "</imgeo:OnbegroeidTerreindeel>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "</imgeo:OnbegroeidTerreindeel>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
@@ -39,6 +39,7 @@ public:
   std::string get_citygml();
   std::string get_mtl();
   std::string get_citygml_imgeo();
+  std::string get_cityjson(ObjVertexTable &dPts);
   bool        get_shape(OGRLayer * layer);
   TopoClass   get_class();
   bool        is_hard();
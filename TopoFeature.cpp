@@ -38,10 +38,16 @@ TopoFeature::TopoFeature(char *wkt, std::string layername, std::vector<std::tupl
   _counter = _count++;
   _toplevel = true;
   _bVerticalWalls = false;
+  _vgridbuilt = false;
+  _nodes = NULL;
+  _nodetag = NODE_GROUND_LAST;
+  _vgridncols = 0;
+  _vgridnrows = 0;
   _p2 = new Polygon2();
   bg::read_wkt(wkt, *_p2);
   bg::unique(*_p2); //-- remove duplicate vertices
   bg::correct(*_p2); //-- correct the orientation of the polygons!
+  _bbox = bg::return_envelope<Box2>(*_p2);
 
   _adjFeatures = new std::vector<TopoFeature*>;
   _p2z.resize(bg::num_interior_rings(*_p2) + 1);
@@ -57,23 +63,42 @@ TopoFeature::TopoFeature(char *wkt, std::string layername, std::vector<std::tupl
 }
 
 TopoFeature::~TopoFeature() {
-  // TODO: clear memory properly
-  std::clog << "I am dead now." << std::endl;
+  delete _p2;
+  delete _adjFeatures;
 }
 
 Box2 TopoFeature::get_bbox2d() {
-  return bg::return_envelope<Box2>(*_p2);
+  return _bbox;
 }
 
 std::string TopoFeature::get_id() {
   return _id;
 }
 
+//-- a span of points sorted in the same cell, only those within radius of the bbox are passed on
+void TopoFeature::add_elevation_points(std::vector<LidarPoint>::const_iterator begin, std::vector<LidarPoint>::const_iterator end, float radius) {
+  double minx = bg::get<bg::min_corner, 0>(_bbox) - radius;
+  double miny = bg::get<bg::min_corner, 1>(_bbox) - radius;
+  double maxx = bg::get<bg::max_corner, 0>(_bbox) + radius;
+  double maxy = bg::get<bg::max_corner, 1>(_bbox) + radius;
+  for (auto it = begin; it != end; ++it) {
+    if (it->x < minx || it->x > maxx || it->y < miny || it->y > maxy)
+      continue;
+    Point2 p(it->x, it->y);
+    this->add_elevation_point(p, it->z, radius, it->lasclass, it->lastreturn);
+  }
+}
+
 bool TopoFeature::buildCDT() {
   getCDT(_p2, _p2z, _vertices, _triangles);
   return true;
 }
 
+//-- estimate of the work of buildCDT(), to schedule the largest first
+std::size_t TopoFeature::get_cdt_cost() {
+  return bg::num_points(*_p2);
+}
+
 int TopoFeature::get_counter() {
   return _counter;
 }
@@ -90,120 +115,106 @@ Polygon2* TopoFeature::get_Polygon2() {
   return _p2;
 }
 
-std::string TopoFeature::get_obj(std::unordered_map< std::string, unsigned long > &dPts, std::string mtl) {
-  std::stringstream ss;
-  ss << mtl << std::endl;
+//-- numbers the vertices in the order of get_obj(), which only looks them up
+void TopoFeature::add_obj_vertices(ObjVertexTable &dPts) {
+  for (auto& t : _triangles) {
+    dPts.get_index(gen_key_bucket(&_vertices[t.v0]));
+    dPts.get_index(gen_key_bucket(&_vertices[t.v1]));
+    dPts.get_index(gen_key_bucket(&_vertices[t.v2]));
+  }
+  for (auto& t : _triangles_vw) {
+    dPts.get_index(gen_key_bucket(&_vertices_vw[t.v0]));
+    dPts.get_index(gen_key_bucket(&_vertices_vw[t.v1]));
+    dPts.get_index(gen_key_bucket(&_vertices_vw[t.v2]));
+  }
+}
+
+std::string TopoFeature::get_obj(const ObjVertexTable &dPts, std::string mtl) {
+  OutputBuffer ss;
+  ss << mtl << "\n";
   for (auto& t : _triangles) {
     unsigned long a, b, c;
-    auto it = dPts.find(gen_key_bucket(&_vertices[t.v0]));
-    if (it == dPts.end()) {
-      // first get the size + 1 and then store the size in dPts due to unspecified order of execution
-      a = dPts.size() + 1;
-      dPts[gen_key_bucket(&_vertices[t.v0])] = a;
-    }
-    else
-      a = it->second;
-    it = dPts.find(gen_key_bucket(&_vertices[t.v1]));
-    if (it == dPts.end()) {
-      b = dPts.size() + 1;
-      dPts[gen_key_bucket(&_vertices[t.v1])] = b;
-    }
-    else
-      b = it->second;
-    it = dPts.find(gen_key_bucket(&_vertices[t.v2]));
-    if (it == dPts.end()) {
-      c = dPts.size() + 1;
-      dPts[gen_key_bucket(&_vertices[t.v2])] = c;
-    }
-    else
-      c = it->second;
+    a = dPts.find_index(gen_key_bucket(&_vertices[t.v0]));
+    b = dPts.find_index(gen_key_bucket(&_vertices[t.v1]));
+    c = dPts.find_index(gen_key_bucket(&_vertices[t.v2]));
     if ((a != b) && (a != c) && (b != c))
-      ss << "f " << a << " " << b << " " << c << std::endl;
+      ss << "f " << a << " " << b << " " << c << "\n";
     // else
     //   std::clog << "COLLAPSED TRIANGLE REMOVED" << std::endl;
   }
 
   //-- vertical triangles
   if (_bVerticalWalls == true && _triangles_vw.size() > 0)
-    ss << mtl << "Wall" << std::endl;
+    ss << mtl << "Wall\n";
 
   for (auto& t : _triangles_vw) {
     unsigned long a, b, c;
-    auto it = dPts.find(gen_key_bucket(&_vertices_vw[t.v0]));
-    if (it == dPts.end()) {
-      a = dPts.size() + 1;
-      dPts[gen_key_bucket(&_vertices_vw[t.v0])] = a;
-    }
-    else
-      a = it->second;
-    it = dPts.find(gen_key_bucket(&_vertices_vw[t.v1]));
-    if (it == dPts.end()) {
-      b = dPts.size() + 1;
-      dPts[gen_key_bucket(&_vertices_vw[t.v1])] = b;
-    }
-    else
-      b = it->second;
-    it = dPts.find(gen_key_bucket(&_vertices_vw[t.v2]));
-    if (it == dPts.end()) {
-      c = dPts.size() + 1;
-      dPts[gen_key_bucket(&_vertices_vw[t.v2])] = c;
-    }
-    else
-      c = it->second;
+    a = dPts.find_index(gen_key_bucket(&_vertices_vw[t.v0]));
+    b = dPts.find_index(gen_key_bucket(&_vertices_vw[t.v1]));
+    c = dPts.find_index(gen_key_bucket(&_vertices_vw[t.v2]));
     if ((a != b) && (a != c) && (b != c))
-      ss << "f " << a << " " << b << " " << c << std::endl;
+      ss << "f " << a << " " << b << " " << c << "\n";
     // else
     //   std::clog << "COLLAPSED TRIANGLE REMOVED" << std::endl;
   }
   return ss.str();
 }
 
-std::string TopoFeature::get_imgeo_object_info(std::string id) {
-  std::stringstream ss;
+//-- the triangles and then the vertical walls, in one mesh
+void TopoFeature::get_mesh(std::vector<Point3> &vertices, std::vector<Triangle> &triangles) {
+  vertices = _vertices;
+  triangles = _triangles;
+  int offset = int(vertices.size());
+  vertices.insert(vertices.end(), _vertices_vw.begin(), _vertices_vw.end());
+  for (auto& t : _triangles_vw) {
+    Triangle tw = { t.v0 + offset, t.v1 + offset, t.v2 + offset };
+    triangles.push_back(tw);
+  }
+}
+
+void TopoFeature::get_imgeo_object_info(OutputBuffer& ss, std::string id) {
   std::string attribute;
   if (get_attribute("creationDate", attribute)) {
-    ss << "<imgeo:creationDate>" << attribute << "</imgeo:creationDate>" << std::endl;
+    ss << "<imgeo:creationDate>" << attribute << "</imgeo:creationDate>\n";
   }
   if (get_attribute("terminationDate", attribute)) {
-    ss << "<imgeo:terminationDate>" << attribute << "</imgeo:terminationDate>" << std::endl;
+    ss << "<imgeo:terminationDate>" << attribute << "</imgeo:terminationDate>\n";
   }
   if (get_attribute("lokaalid", attribute)) {
-    ss << "<imgeo:identificatie>" << std::endl;
-    ss << "<imgeo:NEN3610ID>" << std::endl;
-    ss << "<imgeo:namespace>NL.IMGeo</imgeo:namespace>" << std::endl;
-    ss << "<imgeo:lokaalID>" << attribute << "</imgeo:lokaalID>" << std::endl;
-    ss << "</imgeo:NEN3610ID>" << std::endl;
-    ss << "</imgeo:identificatie>" << std::endl;
+    ss << "<imgeo:identificatie>\n";
+    ss << "<imgeo:NEN3610ID>\n";
+    ss << "<imgeo:namespace>NL.IMGeo</imgeo:namespace>\n";
+    ss << "<imgeo:lokaalID>" << attribute << "</imgeo:lokaalID>\n";
+    ss << "</imgeo:NEN3610ID>\n";
+    ss << "</imgeo:identificatie>\n";
   }
   if (get_attribute("tijdstipregistratie", attribute)) {
-    ss << "<imgeo:tijdstipRegistratie>" << attribute << "</imgeo:tijdstipRegistratie>" << std::endl;
+    ss << "<imgeo:tijdstipRegistratie>" << attribute << "</imgeo:tijdstipRegistratie>\n";
   }
   if (get_attribute("eindregistratie", attribute)) {
-    ss << "<imgeo:eindRegistratie>" << attribute << "</imgeo:eindRegistratie>" << std::endl;
+    ss << "<imgeo:eindRegistratie>" << attribute << "</imgeo:eindRegistratie>\n";
   }
   if (get_attribute("lv-publicatiedatum", attribute)) {
-    ss << "<imgeo:LV-publicatiedatum>" << attribute << "</imgeo:LV-publicatiedatum>" << std::endl;
+    ss << "<imgeo:LV-publicatiedatum>" << attribute << "</imgeo:LV-publicatiedatum>\n";
   }
   if (get_attribute("bronhouder", attribute)) {
-    ss << "<imgeo:bronhouder>" << attribute << "</imgeo:bronhouder>" << std::endl;
+    ss << "<imgeo:bronhouder>" << attribute << "</imgeo:bronhouder>\n";
   }
   if (get_attribute("inonderzoek", attribute)) {
-    ss << "<imgeo:inOnderzoek>" << attribute << "</imgeo:inOnderzoek>" << std::endl;
+    ss << "<imgeo:inOnderzoek>" << attribute << "</imgeo:inOnderzoek>\n";
   }
   if (get_attribute("relatievehoogteligging", attribute)) {
-    ss << "<imgeo:relatieveHoogteligging>" << attribute << "</imgeo:relatieveHoogteligging>" << std::endl;
+    ss << "<imgeo:relatieveHoogteligging>" << attribute << "</imgeo:relatieveHoogteligging>\n";
   }
   if (get_attribute("bgt-status", attribute, "bestaand")) {
-    ss << "<imgeo:bgt-status codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#Status\">" << attribute << "</imgeo:bgt-status>" << std::endl;
+    ss << "<imgeo:bgt-status codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#Status\">" << attribute << "</imgeo:bgt-status>\n";
   }
   if (get_attribute("plus-status", attribute)) {
-    ss << "<imgeo:plus-status>" << attribute << "</imgeo:plus-status>" << std::endl;
+    ss << "<imgeo:plus-status>" << attribute << "</imgeo:plus-status>\n";
   }
-  return ss.str();
 }
 
-std::string TopoFeature::get_citygml_attributes(std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes) {
-  std::stringstream ss;
+void TopoFeature::get_citygml_attributes(OutputBuffer& ss, std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes) {
   for (auto& attribute : attributes) {
     // add attributes except gml_id
     if (std::get<0>(attribute).compare("gml_id") != 0) {
@@ -218,14 +229,87 @@ std::string TopoFeature::get_citygml_attributes(std::vector<std::tuple<std::stri
       default:
         type = "string";
       }
-      ss << "<gen:" + type + "Attribute name=\"" + std::get<0>(attribute) + "\">" << std::endl;
-      ss << "<gen:value>" + std::get<2>(attribute) + "</gen:value>" << std::endl;
-      ss << "</gen:" + type << "Attribute>" << std::endl;
+      ss << "<gen:" + type + "Attribute name=\"" + std::get<0>(attribute) + "\">\n";
+      ss << "<gen:value>" + std::get<2>(attribute) + "</gen:value>\n";
+      ss << "</gen:" + type << "Attribute>\n";
+    }
+  }
+}
+
+//-- the attributes (except gml_id) as the members of a CityJSON "attributes" object
+std::string TopoFeature::get_cityjson_attributes(std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes) {
+  OutputBuffer ss;
+  bool first = true;
+  for (auto& attribute : attributes) {
+    if (std::get<0>(attribute).compare("gml_id") != 0) {
+      if (first == false)
+        ss << ", ";
+      ss << get_json_string(std::get<0>(attribute)) << ": ";
+      const std::string& value = std::get<2>(attribute);
+      if ((std::get<1>(attribute) == OFTInteger || std::get<1>(attribute) == OFTReal) && value.empty() == false)
+        ss << value;
+      else if (std::get<1>(attribute) == OFTInteger || std::get<1>(attribute) == OFTReal)
+        ss << "null";
+      else
+        ss << get_json_string(value);
+      first = false;
     }
   }
   return ss.str();
 }
 
+//-- a member of "CityObjects" with its attributes and geometries
+std::string TopoFeature::get_cityjson_object(std::string type, std::string geometry) {
+  OutputBuffer ss;
+  ss << get_json_string(this->get_id()) << ": {\"type\": \"" << type << "\", ";
+  ss << "\"attributes\": {" << get_cityjson_attributes(_attributes) << "}, ";
+  ss << "\"geometry\": [" << geometry << "]}";
+  return ss.str();
+}
+
+//-- the triangles and the vertical walls as a LOD1 MultiSurface, the vertices are indices
+//-- in dPts so those shared with the adjacent (stitched) features are written once
+std::string TopoFeature::get_cityjson_multisurface(ObjVertexTable &dPts, std::string semantic, std::string semanticwalls) {
+  OutputBuffer ss;
+  std::vector<int> values;
+  ss << "{\"type\": \"MultiSurface\", \"lod\": 1, \"boundaries\": [";
+  bool first = true;
+  for (int w = 0; w < 2; w++) {
+    std::vector<Point3>& vertices = (w == 0) ? _vertices : _vertices_vw;
+    for (auto& t : (w == 0) ? _triangles : _triangles_vw) {
+      unsigned long a, b, c;
+      a = dPts.get_index(gen_key_bucket(&vertices[t.v0]));
+      b = dPts.get_index(gen_key_bucket(&vertices[t.v1]));
+      c = dPts.get_index(gen_key_bucket(&vertices[t.v2]));
+      if ((a == b) || (a == c) || (b == c))
+        continue;
+      if (first == false)
+        ss << ",";
+      ss << "[[" << (a - 1) << "," << (b - 1) << "," << (c - 1) << "]]";
+      values.push_back(w);
+      first = false;
+    }
+  }
+  ss << "]";
+  if (semantic.empty() == false) {
+    ss << ", \"semantics\": {\"surfaces\": [{\"type\": \"" << semantic << "\"}";
+    if (semanticwalls.empty() == false)
+      ss << ", {\"type\": \"" << semanticwalls << "\"}";
+    ss << "], \"values\": [";
+    for (std::size_t i = 0; i < values.size(); i++) {
+      if (i > 0)
+        ss << ",";
+      if (values[i] == 0)
+        ss << "0";
+      else
+        ss << ((semanticwalls.empty() == false) ? "1" : "null");
+    }
+    ss << "]}";
+  }
+  ss << "}";
+  return ss.str();
+}
+
 std::string TopoFeature::get_wkt() {
   //  std::string wkt;
   //  wkt = "MULTIPOLYGONZ (";
@@ -322,7 +406,6 @@ void TopoFeature::fix_bowtie() {
     therings.push_back(iring);
 
   //-- process each vertex of the polygon separately
-  std::vector<int> anc, bnc;
   Point2 a, b;
   TopoFeature* fadj;
   int ringi = -1;
@@ -342,18 +425,11 @@ void TopoFeature::fix_bowtie() {
         bi = ai + 1;
       }
       //-- find the adjacent polygon to segment ab (fadj)
-      fadj = nullptr;
       int adj_a_ringi = 0;
       int adj_a_pi = 0;
       int adj_b_ringi = 0;
       int adj_b_pi = 0;
-      for (auto& adj : *(_adjFeatures)) {
-        if (adj->has_segment(b, a, adj_b_ringi, adj_b_pi, adj_a_ringi, adj_a_pi) == true) {
-          // if (adj->has_segment(b, a) == true) {
-          fadj = adj;
-          break;
-        }
-      }
+      fadj = this->get_twin_edge(ringi, ai, a, b, adj_a_ringi, adj_a_pi, adj_b_ringi, adj_b_pi);
       if (fadj == nullptr)
         continue;
       //-- check height differences: f > fadj for *both* Points a and b
@@ -410,7 +486,7 @@ void TopoFeature::fix_bowtie() {
   }
 }
 
-void TopoFeature::construct_vertical_walls(std::unordered_map<std::string, std::vector<int>> &nc, int baseheight) {
+void TopoFeature::construct_vertical_walls(CoordMap< std::vector<int> > &nc, int baseheight) {
   //std::clog << this->get_id() << std::endl;
   // if (this->get_id() == "bbdc52a89-00b3-11e6-b420-2bdcc4ab5d7f")
   //   std::clog << "break" << std::endl;
@@ -425,8 +501,11 @@ void TopoFeature::construct_vertical_walls(std::unordered_map<std::string, std::
     therings.push_back(iring);
 
   //-- process each vertex of the polygon separately
-  std::vector<int> anc, bnc;
-  std::unordered_map<std::string, std::vector<int>>::const_iterator ncit;
+  //-- (anc/bnc point to the node columns, they keep the last one found)
+  const std::vector<int> empty;
+  const std::vector<int>* ancp = &empty;
+  const std::vector<int>* bncp = &empty;
+  std::vector<int>* ncit;
   Point2 a, b;
   TopoFeature* fadj;
   int ringi = -1;
@@ -449,27 +528,23 @@ void TopoFeature::construct_vertical_walls(std::unordered_map<std::string, std::
       }
       //-- check if there's a nc for either
       ncit = nc.find(gen_key_bucket(&a));
-      if (ncit != nc.end())
-        anc = ncit->second;
+      if (ncit != NULL)
+        ancp = ncit;
       ncit = nc.find(gen_key_bucket(&b));
-      if (ncit != nc.end())
-        bnc = ncit->second;
+      if (ncit != NULL)
+        bncp = ncit;
+      const std::vector<int>& anc = *ancp;
+      const std::vector<int>& bnc = *bncp;
 
       if ((anc.empty() == true) && (bnc.empty() == true))
         continue;
 
       //-- find the adjacent polygon to segment ab (fadj)
-      fadj = nullptr;
       int adj_a_ringi = 0;
       int adj_a_pi = 0;
       int adj_b_ringi = 0;
       int adj_b_pi = 0;
-      for (auto& adj : *(_adjFeatures)) {
-        if (adj->has_segment(b, a, adj_b_ringi, adj_b_pi, adj_a_ringi, adj_a_pi) == true) {
-          fadj = adj;
-          break;
-        }
-      }
+      fadj = this->get_twin_edge(ringi, ai, a, b, adj_a_ringi, adj_a_pi, adj_b_ringi, adj_b_pi);
       if (fadj == nullptr && this->get_class() != BUILDING) {
         continue;
       }
@@ -560,6 +635,58 @@ bool TopoFeature::has_segment(Point2& a, Point2& b, int& aringi, int& api, int&
   return false;
 }
 
+//-- for each edge of the polygon, the first adjacent feature having the reversed edge
+//-- (the same as has_segment(b, a) on each adjacent feature, but with the vertex index)
+void TopoFeature::find_twin_edges(const VertexIndex& vertexindex) {
+  double threshold = 0.001;
+  std::vector<VertexIncidence> incidences;
+  VertexIncidence none = { NULL, 0, 0 };
+  _twinedges.resize(bg::num_interior_rings(*_p2) + 1);
+  for (int ringi = 0; ringi <= int(_p2->inners().size()); ringi++) {
+    const Ring2& ring = (ringi == 0) ? _p2->outer() : _p2->inners()[ringi - 1];
+    _twinedges[ringi].assign(ring.size(), none);
+    for (int ai = 0; ai < int(ring.size()); ai++) {
+      int bi = (ai == (int(ring.size()) - 1)) ? 0 : ai + 1;
+      vertexindex.get_incidences(ring[bi], incidences);
+      bool found = false;
+      for (auto& adj : *(_adjFeatures)) {
+        for (auto& inc : incidences) {
+          if (inc.f != adj)
+            continue;
+          int nextpi;
+          Point2 tmp = adj->get_next_point2_in_ring(inc.ringi, inc.pi, nextpi);
+          if (distance(ring[ai], tmp) <= threshold) {
+            _twinedges[ringi][ai] = inc;
+            found = true;
+            break;
+          }
+        }
+        if (found == true)
+          break;
+      }
+    }
+  }
+}
+
+//-- the adjacent feature with the reversed edge of ab (a is vertex ai of ring ringi), nullptr if none
+TopoFeature* TopoFeature::get_twin_edge(int ringi, int ai, Point2& a, Point2& b, int& adj_a_ringi, int& adj_a_pi, int& adj_b_ringi, int& adj_b_pi) {
+  if (_twinedges.empty() == true) {
+    for (auto& adj : *(_adjFeatures)) {
+      if (adj->has_segment(b, a, adj_b_ringi, adj_b_pi, adj_a_ringi, adj_a_pi) == true)
+        return adj;
+    }
+    return nullptr;
+  }
+  const VertexIncidence& twin = _twinedges[ringi][ai];
+  if (twin.f == NULL)
+    return nullptr;
+  adj_b_ringi = twin.ringi;
+  adj_b_pi = twin.pi;
+  adj_a_ringi = twin.ringi;
+  twin.f->get_next_point2_in_ring(twin.ringi, twin.pi, adj_a_pi);
+  return twin.f;
+}
+
 float TopoFeature::get_distance_to_boundaries(Point2& p) {
   //-- collect the rings of the polygon
   std::vector<Ring2> therings;
@@ -622,20 +749,12 @@ bool TopoFeature::has_point2_(const Point2& p, std::vector<int>& ringis, std::ve
 }
 
 Point2 TopoFeature::get_point2(int ringi, int pi) {
-  Ring2 ring;
-  if (ringi == 0)
-    ring = _p2->outer();
-  else
-    ring = _p2->inners()[ringi - 1];
+  const Ring2& ring = (ringi == 0) ? _p2->outer() : _p2->inners()[ringi - 1];
   return ring[pi];
 }
 
 Point2 TopoFeature::get_next_point2_in_ring(int ringi, int i, int& pi) {
-  Ring2 ring;
-  if (ringi == 0)
-    ring = _p2->outer();
-  else
-    ring = _p2->inners()[ringi - 1];
+  const Ring2& ring = (ringi == 0) ? _p2->outer() : _p2->inners()[ringi - 1];
 
   if (i == (ring.size() - 1)) {
     pi = 0;
@@ -661,37 +780,130 @@ int TopoFeature::get_vertex_elevation(int ringi, int pi) {
 
 int TopoFeature::get_vertex_elevation(Point2& p) {
   std::vector<int> ringis, pis;
-  has_point2_(p, ringis, pis);
+  if (has_point2_(p, ringis, pis) == false)
+    return -9999;
   return _p2z[ringis[0]][pis[0]];
 }
 
+//-- the vertex is looked up in the index (built by Map3d for the stitching) instead of in the rings
+int TopoFeature::get_vertex_elevation(Point2& p, const VertexIndex& vertexindex) {
+  if (vertexindex.is_built() == false)
+    return this->get_vertex_elevation(p);
+  int ringi, pi;
+  if (vertexindex.get_incidence(p, this, ringi, pi) == false)
+    return -9999;
+  return _p2z[ringi][pi];
+}
+
 void TopoFeature::set_vertex_elevation(int ringi, int pi, int z) {
   _p2z[ringi][pi] = z;
 }
 
+//-- registers the vertices in the node table, the points are then added to the nodes (by Map3d)
+//-- and not to the feature anymore
+void TopoFeature::set_nodes(NodeTable* nodes, NodeTag tag) {
+  _nodes = nodes;
+  _nodetag = tag;
+  _nodeids.resize(bg::num_interior_rings(*_p2) + 1);
+  for (int ringi = 0; ringi <= int(_p2->inners().size()); ringi++) {
+    const Ring2& ring = (ringi == 0) ? _p2->outer() : _p2->inners()[ringi - 1];
+    _nodeids[ringi].resize(ring.size());
+    for (int pi = 0; pi < int(ring.size()); pi++)
+      _nodeids[ringi][pi] = _nodes->add_node(ring[pi], tag);
+  }
+  std::vector< std::vector<ZAccumulator> >().swap(_lidarelevs);
+}
+
 //-- used to collect all points linked to the polygon
 //-- later all these values are used to lift the polygon (and put values in _p2z)
 bool TopoFeature::assign_elevation_to_vertex(Point2 &p, double z, float radius) {
+  if (_nodes != NULL)
+    return true;
   int zcm = int(z * 100);
-  int ringi = 0;
-  Ring2 oring = bg::exterior_ring(*(_p2));
-  for (int i = 0; i < oring.size(); i++) {
-    if (distance(p, oring[i]) <= radius)
-      (_lidarelevs[ringi][i]).push_back(zcm);
+  double sqradius = double(radius) * radius;
+  if (_vgridbuilt == false)
+    build_vertex_grid(radius);
+  //-- small polygons: test all the vertices
+  if (_vgridncols == 0) {
+    int ringi = 0;
+    const Ring2& oring = bg::exterior_ring(*(_p2));
+    for (int i = 0; i < oring.size(); i++) {
+      if (bg::comparable_distance(p, oring[i]) <= sqradius)
+        (_lidarelevs[ringi][i]).add(zcm);
+    }
+    ringi++;
+    auto& irings = bg::interior_rings(*(_p2));
+    for (Ring2& iring : irings) {
+      for (int i = 0; i < iring.size(); i++) {
+        if (bg::comparable_distance(p, iring[i]) <= sqradius) {
+          (_lidarelevs[ringi][i]).add(zcm);
+        }
+      }
+      ringi++;
+    }
+    return true;
   }
-  ringi++;
-  auto irings = bg::interior_rings(*(_p2));
-  for (Ring2& iring : irings) {
-    for (int i = 0; i < iring.size(); i++) {
-      if (distance(p, iring[i]) <= radius) {
-        (_lidarelevs[ringi][i]).push_back(zcm);
+  //-- otherwise only the vertices in the cells within radius
+  int col0 = std::max(0, int(std::floor((p.x() - radius - _vgridminx) / _vgridcellsize)));
+  int row0 = std::max(0, int(std::floor((p.y() - radius - _vgridminy) / _vgridcellsize)));
+  int col1 = std::min(_vgridncols - 1, int(std::floor((p.x() + radius - _vgridminx) / _vgridcellsize)));
+  int row1 = std::min(_vgridnrows - 1, int(std::floor((p.y() + radius - _vgridminy) / _vgridcellsize)));
+  for (int row = row0; row <= row1; row++) {
+    for (int col = col0; col <= col1; col++) {
+      int cell = (row * _vgridncols) + col;
+      for (int k = _vgridoffsets[cell]; k < _vgridoffsets[cell + 1]; k++) {
+        int ringi = _vgridvertices[k].first;
+        int pi = _vgridvertices[k].second;
+        const Point2& v = (ringi == 0) ? _p2->outer()[pi] : _p2->inners()[ringi - 1][pi];
+        if (bg::comparable_distance(p, v) <= sqradius)
+          (_lidarelevs[ringi][pi]).add(zcm);
       }
     }
-    ringi++;
   }
   return true;
 }
 
+//-- cells of the size of the radius; the vertices are stored per cell, contiguously
+void TopoFeature::build_vertex_grid(float radius) {
+  _vgridbuilt = true;
+  int nvertices = int(bg::num_points(*_p2));
+  if (nvertices < VERTEX_GRID_THRESHOLD || radius <= 0)
+    return;
+  _vgridminx = bg::get<bg::min_corner, 0>(_bbox);
+  _vgridminy = bg::get<bg::min_corner, 1>(_bbox);
+  double width = bg::get<bg::max_corner, 0>(_bbox) - _vgridminx;
+  double height = bg::get<bg::max_corner, 1>(_bbox) - _vgridminy;
+  _vgridcellsize = radius;
+  //-- not more cells than 4 per vertex, for long and thin polygons
+  while ((std::floor(width / _vgridcellsize) + 1) * (std::floor(height / _vgridcellsize) + 1) > 4.0 * nvertices)
+    _vgridcellsize *= 2;
+  _vgridncols = int(std::floor(width / _vgridcellsize)) + 1;
+  _vgridnrows = int(std::floor(height / _vgridcellsize)) + 1;
+
+  std::vector<int> cells;
+  cells.reserve(nvertices);
+  std::vector< std::pair<int, int> > vertices;
+  vertices.reserve(nvertices);
+  _vgridoffsets.assign((_vgridncols * _vgridnrows) + 1, 0);
+  for (int ringi = 0; ringi <= int(_p2->inners().size()); ringi++) {
+    const Ring2& ring = (ringi == 0) ? _p2->outer() : _p2->inners()[ringi - 1];
+    for (int pi = 0; pi < int(ring.size()); pi++) {
+      int col = std::min(_vgridncols - 1, int((ring[pi].x() - _vgridminx) / _vgridcellsize));
+      int row = std::min(_vgridnrows - 1, int((ring[pi].y() - _vgridminy) / _vgridcellsize));
+      int cell = (row * _vgridncols) + col;
+      cells.push_back(cell);
+      vertices.push_back(std::make_pair(ringi, pi));
+      _vgridoffsets[cell + 1]++;
+    }
+  }
+  for (std::size_t i = 1; i < _vgridoffsets.size(); i++)
+    _vgridoffsets[i] += _vgridoffsets[i - 1];
+  std::vector<int> fill(_vgridoffsets.begin(), _vgridoffsets.end() - 1);
+  _vgridvertices.resize(vertices.size());
+  for (std::size_t i = 0; i < vertices.size(); i++)
+    _vgridvertices[fill[cells[i]]++] = vertices[i];
+}
+
 double TopoFeature::distance(const Point2 &p1, const Point2 &p2) {
   return sqrt((p1.x() - p2.x())*(p1.x() - p2.x()) + (p1.y() - p2.y())*(p1.y() - p2.y()));
 }
@@ -753,54 +965,48 @@ bool TopoFeature::point_in_polygon(Point2 &p, Polygon2 &poly) {
   return insideOuter;
 }
 
-std::string TopoFeature::get_triangle_as_gml_surfacemember(Triangle& t, bool verticalwall) {
-  std::stringstream ss;
-  ss << std::setprecision(3) << std::fixed;
-  ss << "<gml:surfaceMember>" << std::endl;
-  ss << "<gml:Polygon>" << std::endl;
-  ss << "<gml:exterior>" << std::endl;
-  ss << "<gml:LinearRing>" << std::endl;
+void TopoFeature::get_triangle_as_gml_surfacemember(OutputBuffer& ss, Triangle& t, bool verticalwall) {
+  ss << "<gml:surfaceMember>\n";
+  ss << "<gml:Polygon>\n";
+  ss << "<gml:exterior>\n";
+  ss << "<gml:LinearRing>\n";
   if (verticalwall == false) {
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v1]) << " " << bg::get<1>(_vertices[t.v1]) << " " << bg::get<2>(_vertices[t.v1]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v2]) << " " << bg::get<1>(_vertices[t.v2]) << " " << bg::get<2>(_vertices[t.v2]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>" << std::endl;
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v1]) << " " << bg::get<1>(_vertices[t.v1]) << " " << bg::get<2>(_vertices[t.v1]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v2]) << " " << bg::get<1>(_vertices[t.v2]) << " " << bg::get<2>(_vertices[t.v2]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>\n";
   }
   else {
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v1]) << " " << bg::get<1>(_vertices_vw[t.v1]) << " " << bg::get<2>(_vertices_vw[t.v1]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v2]) << " " << bg::get<1>(_vertices_vw[t.v2]) << " " << bg::get<2>(_vertices_vw[t.v2]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>" << std::endl;
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v1]) << " " << bg::get<1>(_vertices_vw[t.v1]) << " " << bg::get<2>(_vertices_vw[t.v1]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v2]) << " " << bg::get<1>(_vertices_vw[t.v2]) << " " << bg::get<2>(_vertices_vw[t.v2]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>\n";
   }
-  ss << "</gml:LinearRing>" << std::endl;
-  ss << "</gml:exterior>" << std::endl;
-  ss << "</gml:Polygon>" << std::endl;
-  ss << "</gml:surfaceMember>" << std::endl;
-  return ss.str();
+  ss << "</gml:LinearRing>\n";
+  ss << "</gml:exterior>\n";
+  ss << "</gml:Polygon>\n";
+  ss << "</gml:surfaceMember>\n";
 }
 
-std::string TopoFeature::get_triangle_as_gml_triangle(Triangle& t, bool verticalwall) {
-  std::stringstream ss;
-  ss << std::setprecision(3) << std::fixed;
-  ss << "<gml:Triangle>" << std::endl;
-  ss << "<gml:exterior>" << std::endl;
-  ss << "<gml:LinearRing>" << std::endl;
+void TopoFeature::get_triangle_as_gml_triangle(OutputBuffer& ss, Triangle& t, bool verticalwall) {
+  ss << "<gml:Triangle>\n";
+  ss << "<gml:exterior>\n";
+  ss << "<gml:LinearRing>\n";
   if (verticalwall == false) {
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v1]) << " " << bg::get<1>(_vertices[t.v1]) << " " << bg::get<2>(_vertices[t.v1]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v2]) << " " << bg::get<1>(_vertices[t.v2]) << " " << bg::get<2>(_vertices[t.v2]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>" << std::endl;
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v1]) << " " << bg::get<1>(_vertices[t.v1]) << " " << bg::get<2>(_vertices[t.v1]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v2]) << " " << bg::get<1>(_vertices[t.v2]) << " " << bg::get<2>(_vertices[t.v2]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices[t.v0]) << " " << bg::get<1>(_vertices[t.v0]) << " " << bg::get<2>(_vertices[t.v0]) << "</gml:pos>\n";
   }
   else {
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v1]) << " " << bg::get<1>(_vertices_vw[t.v1]) << " " << bg::get<2>(_vertices_vw[t.v1]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v2]) << " " << bg::get<1>(_vertices_vw[t.v2]) << " " << bg::get<2>(_vertices_vw[t.v2]) << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>" << std::endl;
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v1]) << " " << bg::get<1>(_vertices_vw[t.v1]) << " " << bg::get<2>(_vertices_vw[t.v1]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v2]) << " " << bg::get<1>(_vertices_vw[t.v2]) << " " << bg::get<2>(_vertices_vw[t.v2]) << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(_vertices_vw[t.v0]) << " " << bg::get<1>(_vertices_vw[t.v0]) << " " << bg::get<2>(_vertices_vw[t.v0]) << "</gml:pos>\n";
   }
-  ss << "</gml:LinearRing>" << std::endl;
-  ss << "</gml:exterior>" << std::endl;
-  ss << "</gml:Triangle>" << std::endl;
-  return ss.str();
+  ss << "</gml:LinearRing>\n";
+  ss << "</gml:exterior>\n";
+  ss << "</gml:Triangle>\n";
 }
 
 bool TopoFeature::get_attribute(std::string attributeName, std::string &attribute, std::string defaultValue)
@@ -847,25 +1053,23 @@ void TopoFeature::lift_each_boundary_vertices(float percentile) {
   int ringi = 0;
   Ring2 oring = bg::exterior_ring(*(_p2));
   for (int i = 0; i < oring.size(); i++) {
-    std::vector<int> &l = _lidarelevs[ringi][i];
-    if (l.empty() == true)
+    if (_nodes != NULL)
+      _p2z[ringi][i] = _nodes->get_percentile(_nodeids[ringi][i], _nodetag, percentile);
+    else if (_lidarelevs[ringi][i].empty() == true)
       _p2z[ringi][i] = -9999;
-    else {
-      std::nth_element(l.begin(), l.begin() + (l.size() * percentile), l.end());
-      _p2z[ringi][i] = l[l.size() * percentile];
-    }
+    else
+      _p2z[ringi][i] = _lidarelevs[ringi][i].get_percentile(percentile);
   }
   ringi++;
   auto irings = bg::interior_rings(*(_p2));
   for (Ring2& iring : irings) {
     for (int i = 0; i < iring.size(); i++) {
-      std::vector<int> &l = _lidarelevs[ringi][i];
-      if (l.empty() == true)
+      if (_nodes != NULL)
+        _p2z[ringi][i] = _nodes->get_percentile(_nodeids[ringi][i], _nodetag, percentile);
+      else if (_lidarelevs[ringi][i].empty() == true)
         _p2z[ringi][i] = -9999;
-      else {
-        std::nth_element(l.begin(), l.begin() + (l.size() * percentile), l.end());
-        _p2z[ringi][i] = l[l.size() * percentile];
-      }
+      else
+        _p2z[ringi][i] = _lidarelevs[ringi][i].get_percentile(percentile);
     }
     ringi++;
   }
@@ -921,7 +1125,7 @@ bool Flat::add_elevation_point(Point2 &p, double z, float radius, LAS14Class las
   if (within_range(p, *(_p2), radius)) {
     int zcm = int(z * 100);
     //-- 1. assign to polygon since within the threshold value (buffering of polygon)
-    _zvaluesinside.push_back(zcm);
+    _zvaluesinside.add(zcm);
   }
   return true;
 }
@@ -932,13 +1136,10 @@ int Flat::get_height() {
 
 bool Flat::lift_percentile(float percentile) {
   int z = 0;
-  if (_zvaluesinside.empty() == false) {
-    std::nth_element(_zvaluesinside.begin(), _zvaluesinside.begin() + (_zvaluesinside.size() * percentile), _zvaluesinside.end());
-    z = _zvaluesinside[_zvaluesinside.size() * percentile];
-  }
+  if (_zvaluesinside.empty() == false)
+    z = _zvaluesinside.get_percentile(percentile);
   this->lift_all_boundary_vertices_same_height(z);
   _zvaluesinside.clear();
-  _zvaluesinside.shrink_to_fit();
   return true;
 }
 
@@ -1039,3 +1240,7 @@ bool TIN::buildCDT() {
   getCDT(_p2, _p2z, _vertices, _triangles, _lidarpts);
   return true;
 }
+
+std::size_t TIN::get_cdt_cost() {
+  return bg::num_points(*_p2) + _lidarpts.size();
+}
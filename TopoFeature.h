@@ -31,15 +31,22 @@
 
 #include "definitions.h"
 #include "geomtools.h"
+#include "ZAccumulator.h"
+#include "NodeTable.h"
+#include "VertexIndex.h"
+#include "OutputBuffer.h"
 #include <random>
 
+#define VERTEX_GRID_THRESHOLD 64 //-- polygons with fewer vertices do not get a vertex grid
+
 class TopoFeature {
 public:
   TopoFeature(char *wkt, std::string layername, std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes, std::string pid);
-  ~TopoFeature();
+  virtual ~TopoFeature();
 
   virtual bool          lift() = 0;
   virtual bool          buildCDT();
+  virtual std::size_t   get_cdt_cost();
   virtual bool          add_elevation_point(Point2 &p, double z, float radius, LAS14Class lasclass, bool lastreturn) = 0;
   virtual int           get_number_vertices() = 0;
   virtual TopoClass     get_class() = 0;
@@ -47,10 +54,13 @@ public:
   virtual std::string   get_mtl() = 0;
   virtual std::string   get_citygml() = 0;
   virtual std::string   get_citygml_imgeo() = 0;
+  virtual std::string   get_cityjson(ObjVertexTable &dPts) = 0;
   virtual bool          get_shape(OGRLayer*) = 0;
 
   std::string  get_id();
-  void         construct_vertical_walls(std::unordered_map< std::string, std::vector<int> > &nc, int baseheight);
+  void         add_elevation_points(std::vector<LidarPoint>::const_iterator begin, std::vector<LidarPoint>::const_iterator end, float radius);
+  void         set_nodes(NodeTable* nodes, NodeTag tag);
+  void         construct_vertical_walls(CoordMap< std::vector<int> > &nc, int baseheight);
   void         fix_bowtie();
   void         add_adjacent_feature(TopoFeature* adjFeature);
   std::vector<TopoFeature*>* get_adjacent_features();
@@ -60,9 +70,12 @@ public:
   Point2       get_point2(int ringi, int pi);
   bool         has_point2_(const Point2& p, std::vector<int>& ringis, std::vector<int>& pis);
   bool         has_segment(Point2& a, Point2& b, int& aringi, int& api, int& bringi, int& bpi);
+  void         find_twin_edges(const VertexIndex& vertexindex);
+  TopoFeature* get_twin_edge(int ringi, int ai, Point2& a, Point2& b, int& adj_a_ringi, int& adj_a_pi, int& adj_b_ringi, int& adj_b_pi);
   float        get_distance_to_boundaries(Point2& p);
   int          get_vertex_elevation(int ringi, int pi);
   int          get_vertex_elevation(Point2& p);
+  int          get_vertex_elevation(Point2& p, const VertexIndex& vertexindex);
   void         set_vertex_elevation(int ringi, int pi, int z);
   void         set_top_level(bool toplevel);
   bool         has_vertical_walls();
@@ -70,13 +83,18 @@ public:
   bool         get_top_level();
   std::string  get_wkt();
   bool         get_shape_features(OGRLayer* layer, std::string className);
-  std::string  get_obj(std::unordered_map< std::string, unsigned long > &dPts, std::string mtl);
-  std::string  get_imgeo_object_info(std::string id);
-  std::string  get_citygml_attributes(std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes);
+  void         add_obj_vertices(ObjVertexTable &dPts);
+  std::string  get_obj(const ObjVertexTable &dPts, std::string mtl);
+  void         get_mesh(std::vector<Point3> &vertices, std::vector<Triangle> &triangles);
+  void         get_imgeo_object_info(OutputBuffer& ss, std::string id);
+  void         get_citygml_attributes(OutputBuffer& ss, std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes);
+  std::string  get_cityjson_attributes(std::vector<std::tuple<std::string, OGRFieldType, std::string>> attributes);
 protected:
   Polygon2*                         _p2;
+  Box2                              _bbox;
   std::vector< std::vector<int> >   _p2z;
   std::vector<TopoFeature*>*        _adjFeatures;
+  std::vector< std::vector<VertexIncidence> > _twinedges; //-- per edge, the first vertex of the reversed edge in an adjacent feature
   std::string                       _id;
   int                               _counter;
   static int                        _count;
@@ -85,22 +103,38 @@ protected:
   std::string                       _layername;
   std::vector<std::tuple<std::string, OGRFieldType, std::string>> _attributes;
 
-  std::vector< std::vector< std::vector<int> > > _lidarelevs; //-- used to collect all LiDAR points linked to the polygon
+  std::vector< std::vector<ZAccumulator> > _lidarelevs; //-- used to collect all LiDAR points linked to the polygon
+  NodeTable*                        _nodes;   //-- if set, the LiDAR points of the vertices are collected in the shared nodes
+  NodeTag                           _nodetag;
+  std::vector< std::vector<int> >   _nodeids;
   std::vector<Point3>   _vertices;  //-- output of Triangle
   std::vector<Triangle> _triangles; //-- output of Triangle
   std::vector<Point3>   _vertices_vw;  //-- for vertical walls
   std::vector<Triangle> _triangles_vw; //-- for vertical walls
 
+  //-- grid over the vertices of the rings, built at the first assign_elevation_to_vertex()
+  bool                  _vgridbuilt;
+  double                _vgridminx;
+  double                _vgridminy;
+  double                _vgridcellsize;
+  int                   _vgridncols;  //-- 0 when the polygon is too small for a grid
+  int                   _vgridnrows;
+  std::vector<int>      _vgridoffsets;
+  std::vector< std::pair<int, int> > _vgridvertices; //-- (ringi, pi) of the vertices of each cell
+
   Point2  get_next_point2_in_ring(int ringi, int i, int& pi);
   bool    assign_elevation_to_vertex(Point2 &p, double z, float radius);
+  void    build_vertex_grid(float radius);
   double  distance(const Point2 &p1, const Point2 &p2);
   bool    within_range(Point2 &p, Polygon2 &oly, double radius);
   bool    point_in_polygon(Point2 &p, Polygon2 &poly);
   void    lift_each_boundary_vertices(float percentile);
   void    lift_all_boundary_vertices_same_height(int height);
 
-  std::string get_triangle_as_gml_surfacemember(Triangle& t, bool verticalwall = false);
-  std::string get_triangle_as_gml_triangle(Triangle& t, bool verticalwall = false);
+  void        get_triangle_as_gml_surfacemember(OutputBuffer& ss, Triangle& t, bool verticalwall = false);
+  void        get_triangle_as_gml_triangle(OutputBuffer& ss, Triangle& t, bool verticalwall = false);
+  std::string get_cityjson_object(std::string type, std::string geometry);
+  std::string get_cityjson_multisurface(ObjVertexTable &dPts, std::string semantic = "", std::string semanticwalls = "");
   bool get_attribute(std::string attributeName, std::string &attribute, std::string defaultValue = "");
 };
 
@@ -117,7 +151,7 @@ public:
   virtual bool        lift() = 0;
   virtual std::string get_citygml() = 0;
 protected:
-  std::vector<int>    _zvaluesinside;
+  ZAccumulator        _zvaluesinside;
   bool                lift_percentile(float percentile);
 };
 
@@ -149,6 +183,7 @@ public:
   virtual bool        lift() = 0;
   virtual std::string get_citygml() = 0;
   bool                buildCDT();
+  std::size_t         get_cdt_cost();
 protected:
   int                 _simplification;
   float               _innerbuffer;
@@ -0,0 +1,153 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "VertexIndex.h"
+#include "TopoFeature.h"
+
+#define VERTEX_INDEX_TOLERANCE 0.001 //-- same as TopoFeature::has_point2_()
+
+static bool same_location(const Point2 &p1, const Point2 &p2) {
+  return (p1.x() == p2.x() && p1.y() == p2.y());
+}
+
+VertexIndex::VertexIndex() {
+  _built = false;
+}
+
+void VertexIndex::build(const std::vector<TopoFeature*> &features) {
+  this->clear();
+  std::vector< std::pair<CoordKey, std::size_t> > keys;
+  for (auto& f : features) {
+    Polygon2* p2 = f->get_Polygon2();
+    for (int ringi = 0; ringi <= int(p2->inners().size()); ringi++) {
+      const Ring2& ring = (ringi == 0) ? p2->outer() : p2->inners()[ringi - 1];
+      for (int pi = 0; pi < int(ring.size()); pi++) {
+        Point2 p = ring[pi];
+        VertexIncidence inc = { f, ringi, pi };
+        keys.push_back(std::make_pair(gen_key_bucket(&p), _incidences.size()));
+        _incidences.push_back(inc);
+        _points.push_back(p);
+      }
+    }
+  }
+  //-- group per key, keeping the order of the features/rings/vertices
+  std::stable_sort(keys.begin(), keys.end(), [](const std::pair<CoordKey, std::size_t>& a, const std::pair<CoordKey, std::size_t>& b) {
+    if (a.first.x != b.first.x)
+      return a.first.x < b.first.x;
+    return a.first.y < b.first.y;
+  });
+  std::vector<VertexIncidence> incidences(keys.size());
+  std::vector<Point2> points(keys.size());
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    incidences[i] = _incidences[keys[i].second];
+    points[i] = _points[keys[i].second];
+    std::pair<int, int>& range = _cells[keys[i].first];
+    if (range.second == 0)
+      range.first = int(i);
+    range.second = int(i + 1);
+  }
+  _incidences.swap(incidences);
+  _points.swap(points);
+  _built = true;
+}
+
+void VertexIndex::clear() {
+  _cells.clear();
+  std::vector<VertexIncidence>().swap(_incidences);
+  std::vector<Point2>().swap(_points);
+  _built = false;
+}
+
+bool VertexIndex::is_built() const {
+  return _built;
+}
+
+//-- features with a vertex within the tolerance of p; as with has_point2_() only the
+//-- first such vertex of each ring is returned
+void VertexIndex::get_incidences(const Point2 &p, std::vector<VertexIncidence> &incidences) const {
+  incidences.clear();
+  Point2 tmp = p;
+  CoordKey key = gen_key_bucket(&tmp);
+  for (int dx = -1; dx <= 1; dx++) {
+    for (int dy = -1; dy <= 1; dy++) {
+      CoordKey k = { key.x + dx, key.y + dy, 0 };
+      const std::pair<int, int>* range = _cells.find(k);
+      if (range == NULL)
+        continue;
+      for (int i = range->first; i < range->second; i++) {
+        if (bg::distance(p, _points[i]) <= VERTEX_INDEX_TOLERANCE)
+          incidences.push_back(_incidences[i]);
+      }
+    }
+  }
+  std::sort(incidences.begin(), incidences.end(), [](const VertexIncidence& a, const VertexIncidence& b) {
+    if (a.f != b.f)
+      return a.f->get_counter() < b.f->get_counter();
+    if (a.ringi != b.ringi)
+      return a.ringi < b.ringi;
+    return a.pi < b.pi;
+  });
+  incidences.erase(std::unique(incidences.begin(), incidences.end(), [](const VertexIncidence& a, const VertexIncidence& b) {
+    return (a.f == b.f && a.ringi == b.ringi);
+  }), incidences.end());
+}
+
+//-- the first vertex of feature f at p
+bool VertexIndex::get_incidence(const Point2 &p, const TopoFeature* f, int &ringi, int &pi) const {
+  std::vector<VertexIncidence> incidences;
+  this->get_incidences(p, incidences);
+  for (auto& inc : incidences) {
+    if (inc.f == f) {
+      ringi = inc.ringi;
+      pi = inc.pi;
+      return true;
+    }
+  }
+  return false;
+}
+
+//-- the other features with a vertex at exactly the same location as a vertex of f (sorted)
+void VertexIndex::get_shared_vertices(TopoFeature* f, std::vector<TopoFeature*> &features) const {
+  features.clear();
+  Polygon2* p2 = f->get_Polygon2();
+  for (int ringi = 0; ringi <= int(p2->inners().size()); ringi++) {
+    const Ring2& ring = (ringi == 0) ? p2->outer() : p2->inners()[ringi - 1];
+    for (int pi = 0; pi < int(ring.size()); pi++) {
+      Point2 p = ring[pi];
+      const std::pair<int, int>* range = _cells.find(gen_key_bucket(&p));
+      if (range == NULL)
+        continue;
+      for (int i = range->first; i < range->second; i++) {
+        if (_incidences[i].f != f && same_location(_points[i], p) == true)
+          features.push_back(_incidences[i].f);
+      }
+    }
+  }
+  std::sort(features.begin(), features.end());
+  features.erase(std::unique(features.begin(), features.end()), features.end());
+}
@@ -0,0 +1,61 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef VertexIndex_h
+#define VertexIndex_h
+
+#include "definitions.h"
+#include "CoordMap.h"
+
+class TopoFeature;
+
+typedef struct VertexIncidence {
+  TopoFeature* f;
+  int          ringi;
+  int          pi;
+} VertexIncidence;
+
+//-- all the vertices of the features, per location snapped to the mm, to find the
+//-- features (and their ring/vertex) at a location without scanning their rings
+class VertexIndex {
+public:
+  VertexIndex();
+  void build(const std::vector<TopoFeature*> &features);
+  void clear();
+  bool is_built() const;
+  void get_incidences(const Point2 &p, std::vector<VertexIncidence> &incidences) const;
+  bool get_incidence(const Point2 &p, const TopoFeature* f, int &ringi, int &pi) const;
+  void get_shared_vertices(TopoFeature* f, std::vector<TopoFeature*> &features) const;
+private:
+  CoordMap< std::pair<int, int> > _cells;  //-- range in _incidences of each mm
+  std::vector<VertexIncidence>    _incidences;
+  std::vector<Point2>             _points;
+  bool                            _built;
+};
+
+#endif /* VertexIndex_h */
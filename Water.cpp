@@ -53,7 +53,7 @@ bool Water::add_elevation_point(Point2 &p, double z, float radius, LAS14Class la
   if (point_in_polygon(p, *(_p2))) {
     int zcm = int(z * 100);
     //-- 1. assign to polygon since within the threshold value (buffering of polygon)
-    _zvaluesinside.push_back(zcm);
+    _zvaluesinside.add(zcm);
   }
   return true;
 }
@@ -64,64 +64,66 @@ bool Water::lift() {
 }
 
 std::string Water::get_citygml() {
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
-  ss << "<wtr:WaterBody gml:id=\"" << this->get_id() << "\">" << std::endl;
-  ss << get_citygml_attributes(_attributes);
-  ss << "<wtr:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
+  ss << "<wtr:WaterBody gml:id=\"" << this->get_id() << "\">\n";
+  get_citygml_attributes(ss, _attributes);
+  ss << "<wtr:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</wtr:lod1MultiSurface>" << std::endl;
-  ss << "</wtr:WaterBody>" << std::endl;
-  ss << "</cityObjectMember>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</wtr:lod1MultiSurface>\n";
+  ss << "</wtr:WaterBody>\n";
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
+std::string Water::get_cityjson(ObjVertexTable &dPts) {
+  return get_cityjson_object("WaterBody", get_cityjson_multisurface(dPts, "WaterSurface"));
+}
+
 std::string Water::get_citygml_imgeo() {
   bool ondersteunend = _layername == "ondersteunendwaterdeel";
-  std::stringstream ss;
-  ss << "<cityObjectMember>" << std::endl;
+  OutputBuffer ss;
+  ss << "<cityObjectMember>\n";
   if (ondersteunend) {
-    ss << "<imgeo:OndersteunendWaterdeel gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<imgeo:OndersteunendWaterdeel gml:id=\"" << this->get_id() << "\">\n";
   }
   else {
-    ss << "<imgeo:Waterdeel gml:id=\"" << this->get_id() << "\">" << std::endl;
+    ss << "<imgeo:Waterdeel gml:id=\"" << this->get_id() << "\">\n";
   }
-  ss << get_imgeo_object_info(this->get_id());
-  ss << "<wtr:lod1MultiSurface>" << std::endl;
-  ss << "<gml:MultiSurface>" << std::endl;
-  ss << std::setprecision(3) << std::fixed;
+  get_imgeo_object_info(ss, this->get_id());
+  ss << "<wtr:lod1MultiSurface>\n";
+  ss << "<gml:MultiSurface>\n";
   for (auto& t : _triangles)
-    ss << get_triangle_as_gml_surfacemember(t);
+    get_triangle_as_gml_surfacemember(ss, t);
   for (auto& t : _triangles_vw)
-    ss << get_triangle_as_gml_surfacemember(t, true);
-  ss << "</gml:MultiSurface>" << std::endl;
-  ss << "</wtr:lod1MultiSurface>" << std::endl;
+    get_triangle_as_gml_surfacemember(ss, t, true);
+  ss << "</gml:MultiSurface>\n";
+  ss << "</wtr:lod1MultiSurface>\n";
   std::string attribute;
   if (ondersteunend) {
     if (get_attribute("bgt-type", attribute)) {
-      ss << "<wat:class codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWaterdeel\">" << attribute << "</wat:class>" << std::endl;
+      ss << "<wat:class codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWaterdeel\">" << attribute << "</wat:class>\n";
     }
     if (get_attribute("plus-type", attribute)) {
-      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWaterdeelPlus\">" << attribute << "</imgeo:plus-type>" << std::endl;
+      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeOndersteunendWaterdeelPlus\">" << attribute << "</imgeo:plus-type>\n";
     }
-    ss << "</imgeo:OndersteunendWaterdeel>" << std::endl;
+    ss << "</imgeo:OndersteunendWaterdeel>\n";
   }
   else {
     if (get_attribute("bgt-type", attribute)) {
-      ss << "<wat:class codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeWater\">" << attribute << "</wat:class>" << std::endl;
+      ss << "<wat:class codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeWater\">" << attribute << "</wat:class>\n";
     }
     if (get_attribute("plus-type", attribute)) {
-      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeWaterPlus\">" << attribute << "</imgeo:plus-type>" << std::endl;
+      ss << "<imgeo:plus-type codeSpace=\"http://www.geostandaarden.nl/imgeo/def/2.1#TypeWaterPlus\">" << attribute << "</imgeo:plus-type>\n";
     }
-    ss << "</imgeo:Waterdeel>" << std::endl;
+    ss << "</imgeo:Waterdeel>\n";
   }
-  ss << "</cityObjectMember>" << std::endl;
+  ss << "</cityObjectMember>\n";
   return ss.str();
 }
 
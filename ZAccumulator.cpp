@@ -0,0 +1,133 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "ZAccumulator.h"
+#include <algorithm>
+
+bool ZAccumulator::_histogram = false;
+int  ZAccumulator::_bins = 128;
+
+ZAccumulator::ZAccumulator() {
+  _n = 0;
+  _lo = 0;
+  _width = 1;
+  _min = 0;
+  _max = 0;
+}
+
+void ZAccumulator::set_histogram(bool histogram, int bins) {
+  _histogram = histogram;
+  _bins = std::max(bins, 2);
+}
+
+void ZAccumulator::add(int z) {
+  if (_n == 0 || z < _min)
+    _min = z;
+  if (_n == 0 || z > _max)
+    _max = z;
+  _n++;
+  if (_counts.empty()) {
+    _values.push_back(z);
+    if (_histogram && int(_values.size()) > _bins)
+      to_histogram();
+    return;
+  }
+  if (z < _lo || (long long)(z) - _lo >= (long long)(_width) * _bins)
+    rebin(_min, _max);
+  _counts[(z - _lo) / _width]++;
+}
+
+bool ZAccumulator::empty() const {
+  return (_n == 0);
+}
+
+std::size_t ZAccumulator::size() const {
+  return _n;
+}
+
+//-- value of rank size*percentile, as with std::nth_element on all the values
+int ZAccumulator::get_percentile(float percentile) {
+  if (_n == 0)
+    return 0;
+  std::size_t k = std::min(std::size_t(_n * percentile), std::size_t(_n - 1));
+  if (_counts.empty()) {
+    std::nth_element(_values.begin(), _values.begin() + k, _values.end());
+    return _values[k];
+  }
+  //-- linear interpolation inside the bin of rank k
+  std::size_t cumul = 0;
+  for (int i = 0; i < _bins; i++) {
+    if (cumul + _counts[i] > k) {
+      double frac = ((k - cumul) + 0.5) / _counts[i];
+      int z = _lo + (i * _width) + int(frac * _width);
+      return std::max(_min, std::min(_max, z));
+    }
+    cumul += _counts[i];
+  }
+  return _max;
+}
+
+void ZAccumulator::clear() {
+  std::vector<int>().swap(_values);
+  std::vector<uint32_t>().swap(_counts);
+  _n = 0;
+  _lo = 0;
+  _width = 1;
+}
+
+void ZAccumulator::to_histogram() {
+  _counts.assign(_bins, 0);
+  _width = 1;
+  _lo = _min;
+  rebin(_min, _max);
+  for (int z : _values)
+    _counts[(z - _lo) / _width]++;
+  std::vector<int>().swap(_values);
+}
+
+//-- widens the bins (x2 each time) until [zmin, zmax] fits, and merges the counts
+void ZAccumulator::rebin(int zmin, int zmax) {
+  int width = _width;
+  long long lo;
+  while (true) {
+    lo = (zmin >= 0) ? (zmin / width) * (long long)(width) : -((((long long)(-zmin) + width - 1) / width) * width);
+    if ((long long)(zmax) - lo < (long long)(width) * _bins)
+      break;
+    width *= 2;
+  }
+  if (width == _width && lo == _lo)
+    return;
+  std::vector<uint32_t> counts(_bins, 0);
+  for (int i = 0; i < _bins; i++) {
+    if (_counts[i] > 0)
+      counts[((_lo + (long long)(i) * _width) - lo) / width] += _counts[i];
+  }
+  _counts.swap(counts);
+  _lo = int(lo);
+  _width = width;
+}
@@ -0,0 +1,68 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef ZAccumulator_h
+#define ZAccumulator_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//-- collects the elevations (in cm) assigned to a vertex or a polygon, to get a percentile.
+//-- exact mode keeps all the values (percentile with nth_element).
+//-- histogram mode keeps them exactly until there are more than the # of bins, then switches
+//-- to a histogram of that many bins whose width doubles when the range of the values grows;
+//-- the memory is then constant and the percentile is within one bin width.
+class ZAccumulator {
+public:
+  ZAccumulator();
+
+  void        add(int z);
+  bool        empty() const;
+  std::size_t size() const;
+  int         get_percentile(float percentile);
+  void        clear();
+
+  static void set_histogram(bool histogram, int bins);
+private:
+  std::vector<int>      _values;
+  std::vector<uint32_t> _counts;
+  uint32_t              _n;
+  int                   _lo;     //-- start of the first bin
+  int                   _width;  //-- width of a bin in cm
+  int                   _min;
+  int                   _max;
+
+  static bool           _histogram;
+  static int            _bins;
+
+  void to_histogram();
+  void rebin(int zmin, int zmax);
+};
+
+#endif /* ZAccumulator_h */
@@ -49,6 +49,12 @@ typedef struct PolygonFile {
   std::vector< std::pair<std::string, std::string> > layers;
 } PolygonFile;
 
+typedef struct PointFile {
+  std::string filename;
+  std::vector<int> lasomits;
+  int thinning;
+} PointFile;
+
 typedef enum {
    BUILDING   = 0,
    WATER      = 1,
@@ -68,4 +74,14 @@ typedef enum {
   LAS_BRIDGE       =  26
 } LAS14Class;
 
+typedef struct LidarPoint {
+  double     x;
+  double     y;
+  double     z;
+  LAS14Class lasclass;
+  int        rawclass;   //-- the class in the LAS file
+  uint32_t   index;      //-- the position of the point in the LAS file, for the thinning
+  bool       lastreturn;
+} LidarPoint;
+
 #endif
@@ -182,30 +182,104 @@ bool getCDT(const Polygon2* pgn,
   return true;
 }
 
-std::string gen_key_bucket(Point2* p) {
-  std::string x = std::to_string(bg::get<0>(p));
-  x = x.substr(0, x.find_first_of(".") + 4);
-  std::string y = std::to_string(bg::get<1>(p));
-  y = y.substr(0, y.find_first_of(".") + 4);
-  return (x + " " + y);
-}
-
-std::string gen_key_bucket(Point3* p) {
-  std::string x = std::to_string(bg::get<0>(p));
-  x = x.substr(0, x.find_first_of(".") + 4);
-  std::string y = std::to_string(bg::get<1>(p));
-  y = y.substr(0, y.find_first_of(".") + 4);
-  std::string z = std::to_string(bg::get<2>(p));
-  z = z.substr(0, z.find_first_of(".") + 4);
-  return (x + " " + y + " " + z);
-}
-
-std::string gen_key_bucket(Point3* p, int z) {
-  std::string x = std::to_string(bg::get<0>(p));
-  x = x.substr(0, x.find_first_of(".") + 4);
-  std::string y = std::to_string(bg::get<1>(p));
-  y = y.substr(0, y.find_first_of(".") + 4);
-  std::string zstr = std::to_string(z_to_float(z));
-  zstr = zstr.substr(0, zstr.find_first_of(".") + 4);
-  return (x + " " + y + " " + zstr);
+//-- interleave the bits of x and y to get the position along a Z-order curve
+uint64_t morton_code(uint32_t x, uint32_t y) {
+  uint64_t mx = x;
+  uint64_t my = y;
+  mx = (mx | (mx << 16)) & 0x0000FFFF0000FFFFULL;
+  mx = (mx | (mx << 8)) & 0x00FF00FF00FF00FFULL;
+  mx = (mx | (mx << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  mx = (mx | (mx << 2)) & 0x3333333333333333ULL;
+  mx = (mx | (mx << 1)) & 0x5555555555555555ULL;
+  my = (my | (my << 16)) & 0x0000FFFF0000FFFFULL;
+  my = (my | (my << 8)) & 0x00FF00FF00FF00FFULL;
+  my = (my | (my << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  my = (my | (my << 2)) & 0x3333333333333333ULL;
+  my = (my | (my << 1)) & 0x5555555555555555ULL;
+  return mx | (my << 1);
+}
+
+//-- coordinate in mm, truncated as the first 3 decimals of std::to_string()
+int64_t quantise_mm(double v) {
+  return std::llround(v * 1e6) / 1000;
+}
+
+CoordKey gen_key_bucket(Point2* p) {
+  CoordKey key = { quantise_mm(bg::get<0>(p)), quantise_mm(bg::get<1>(p)), 0 };
+  return key;
+}
+
+CoordKey gen_key_bucket(Point3* p) {
+  CoordKey key = { quantise_mm(bg::get<0>(p)), quantise_mm(bg::get<1>(p)), quantise_mm(bg::get<2>(p)) };
+  return key;
+}
+
+CoordKey gen_key_bucket(Point3* p, int z) {
+  CoordKey key = { quantise_mm(bg::get<0>(p)), quantise_mm(bg::get<1>(p)), quantise_mm(z_to_float(z)) };
+  return key;
+}
+
+CoordKey gen_key_bucket(Point2* p, int z) {
+  CoordKey key = { quantise_mm(bg::get<0>(p)), quantise_mm(bg::get<1>(p)), quantise_mm(z_to_float(z)) };
+  return key;
+}
+
+//-- index (from 1) of the vertex in the OBJ file, a new vertex gets the next index
+unsigned long ObjVertexTable::get_index(const CoordKey& key) {
+  unsigned long& id = _ids[key];
+  if (id == 0) {
+    id = _ids.size();
+    _newvertices.push_back(key);
+  }
+  return id;
+}
+
+//-- 0 if the vertex is not numbered
+unsigned long ObjVertexTable::find_index(const CoordKey& key) const {
+  const unsigned long* id = _ids.find(key);
+  return (id == NULL) ? 0 : *id;
+}
+
+void ObjVertexTable::write_new_vertices(std::string& out) {
+  OutputBuffer buf;
+  for (auto& key : _newvertices) {
+    buf << "v ";
+    buf.append_mm(key.x);
+    buf << ' ';
+    buf.append_mm(key.y);
+    buf << ' ';
+    buf.append_mm(key.z);
+    buf << '\n';
+  }
+  out += buf.str();
+  _newvertices.clear();
+}
+
+//-- the vertices as integer mm relative to translate, as in the "vertices" of a CityJSON file
+void ObjVertexTable::write_new_vertices_json(std::ostream& out, const CoordKey& translate) {
+  OutputBuffer buf;
+  bool first = (_ids.size() == _newvertices.size());
+  for (auto& key : _newvertices) {
+    if (first == false)
+      buf << ",\n";
+    buf << "[" << (key.x - translate.x) << "," << (key.y - translate.y) << "," << (key.z - translate.z) << "]";
+    first = false;
+  }
+  buf.write(out);
+  _newvertices.clear();
+}
+
+std::size_t ObjVertexTable::size() const {
+  return _ids.size();
+}
+
+//-- "x y z" with 3 decimals, as for a vertex of an OBJ file
+std::string key_bucket_to_string(const CoordKey& key) {
+  OutputBuffer buf;
+  buf.append_mm(key.x);
+  buf << ' ';
+  buf.append_mm(key.y);
+  buf << ' ';
+  buf.append_mm(key.z);
+  return buf.str();
 }
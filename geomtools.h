@@ -30,11 +30,33 @@
 #define geomtools_h
 
 #include "definitions.h"
+#include "CoordMap.h"
 #include <random>
 
-std::string gen_key_bucket(Point2* p);
-std::string gen_key_bucket(Point3* p);
-std::string gen_key_bucket(Point3* p, int z);
+int64_t  quantise_mm(double v);
+CoordKey gen_key_bucket(Point2* p);
+CoordKey gen_key_bucket(Point3* p);
+CoordKey gen_key_bucket(Point3* p, int z);
+CoordKey gen_key_bucket(Point2* p, int z);
+std::string key_bucket_to_string(const CoordKey& key);
+
+//-- the vertices of an OBJ file, numbered (from 1) in the order they are first used. The
+//-- vertices added since the last write_new_vertices() are kept until they are written,
+//-- so the file is written batch by batch with the vertices just before their faces.
+//-- find_index() does not modify the table, the threads can use it at the same time.
+class ObjVertexTable {
+public:
+  unsigned long get_index(const CoordKey& key);
+  unsigned long find_index(const CoordKey& key) const;
+  void          write_new_vertices(std::string& out);
+  void          write_new_vertices_json(std::ostream& out, const CoordKey& translate);
+  std::size_t   size() const;
+private:
+  CoordMap<unsigned long> _ids;
+  std::vector<CoordKey>   _newvertices;
+};
+
+uint64_t morton_code(uint32_t x, uint32_t y);
 
 bool triangle_contains_segment(Triangle t, int a, int b);
 bool getCDT(const Polygon2* pgn,
@@ -27,6 +27,8 @@
 */
 
 #include "io.h"
+#include <cstring>
+#include <boost/filesystem/operations.hpp>
 
 void printProgressBar(int percent) {
   std::string bar;
@@ -51,114 +53,134 @@ std::string get_xml_header() {
 }
 
 std::string get_citygml_namespaces() {
-  std::stringstream ss;
-  ss << "<CityModel xmlns=\"http://www.opengis.net/citygml/2.0\"" << std::endl;
-  ss << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"" << std::endl;
-  ss << "xmlns:xAL=\"urn:oasis:names:tc:ciq:xsdschema:xAL:2.0\"" << std::endl;
-  ss << "xmlns:xlink=\"http://www.w3.org/1999/xlink\"" << std::endl;
-  ss << "xmlns:gml=\"http://www.opengis.net/gml\"" << std::endl;
-  ss << "xmlns:bldg=\"http://www.opengis.net/citygml/building/2.0\"" << std::endl;
-  ss << "xmlns:wtr=\"http://www.opengis.net/citygml/waterbody/2.0\"" << std::endl;
-  ss << "xmlns:veg=\"http://www.opengis.net/citygml/vegetation/2.0\"" << std::endl;
-  ss << "xmlns:dem=\"http://www.opengis.net/citygml/relief/2.0\"" << std::endl;
-  ss << "xmlns:tran=\"http://www.opengis.net/citygml/transportation/2.0\"" << std::endl;
-  ss << "xmlns:luse=\"http://www.opengis.net/citygml/landuse/2.0\"" << std::endl;
-  ss << "xmlns:gen=\"http://www.opengis.net/citygml/generics/2.0\"" << std::endl;
-  ss << "xmlns:brg=\"http://www.opengis.net/citygml/bridge/2.0\"" << std::endl;
-  ss << "xmlns:app=\"http://www.opengis.net/citygml/appearance/2.0\"" << std::endl;
-  ss << "xmlns:tun=\"http://www.opengis.net/citygml/tunnel/2.0\"" << std::endl;
-  ss << "xmlns:cif=\"http://www.opengis.net/citygml/cityfurniture/2.0\"" << std::endl;
+  OutputBuffer ss;
+  ss << "<CityModel xmlns=\"http://www.opengis.net/citygml/2.0\"\n";
+  ss << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n";
+  ss << "xmlns:xAL=\"urn:oasis:names:tc:ciq:xsdschema:xAL:2.0\"\n";
+  ss << "xmlns:xlink=\"http://www.w3.org/1999/xlink\"\n";
+  ss << "xmlns:gml=\"http://www.opengis.net/gml\"\n";
+  ss << "xmlns:bldg=\"http://www.opengis.net/citygml/building/2.0\"\n";
+  ss << "xmlns:wtr=\"http://www.opengis.net/citygml/waterbody/2.0\"\n";
+  ss << "xmlns:veg=\"http://www.opengis.net/citygml/vegetation/2.0\"\n";
+  ss << "xmlns:dem=\"http://www.opengis.net/citygml/relief/2.0\"\n";
+  ss << "xmlns:tran=\"http://www.opengis.net/citygml/transportation/2.0\"\n";
+  ss << "xmlns:luse=\"http://www.opengis.net/citygml/landuse/2.0\"\n";
+  ss << "xmlns:gen=\"http://www.opengis.net/citygml/generics/2.0\"\n";
+  ss << "xmlns:brg=\"http://www.opengis.net/citygml/bridge/2.0\"\n";
+  ss << "xmlns:app=\"http://www.opengis.net/citygml/appearance/2.0\"\n";
+  ss << "xmlns:tun=\"http://www.opengis.net/citygml/tunnel/2.0\"\n";
+  ss << "xmlns:cif=\"http://www.opengis.net/citygml/cityfurniture/2.0\"\n";
   ss << "xsi:schemaLocation=\"http://www.opengis.net/citygml/2.0 ./CityGML_2.0/CityGML.xsd\">";
   return ss.str();
 }
 
 std::string get_citygml_imgeo_namespaces() {
-  std::stringstream ss;
-  ss << "<CityModel xmlns=\"http://www.opengis.net/citygml/2.0\"" << std::endl;
-  ss << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"" << std::endl;
-  ss << "xmlns:xAL=\"urn:oasis:names:tc:ciq:xsdschema:xAL:2.0\"" << std::endl;
-  ss << "xmlns:xlink=\"http://www.w3.org/1999/xlink\"" << std::endl;
-  ss << "xmlns:gml=\"http://www.opengis.net/gml\"" << std::endl;
-  ss << "xmlns:bui=\"http://www.opengis.net/citygml/building/2.0\"" << std::endl;
-  ss << "xmlns:wtr=\"http://www.opengis.net/citygml/waterbody/2.0\"" << std::endl;
-  ss << "xmlns:veg=\"http://www.opengis.net/citygml/vegetation/2.0\"" << std::endl;
-  ss << "xmlns:dem=\"http://www.opengis.net/citygml/relief/2.0\"" << std::endl;
-  ss << "xmlns:tra=\"http://www.opengis.net/citygml/transportation/2.0\"" << std::endl;
-  ss << "xmlns:lu=\"http://www.opengis.net/citygml/landuse/2.0\"" << std::endl;
-  ss << "xmlns:gen=\"http://www.opengis.net/citygml/generics/2.0\"" << std::endl;
-  ss << "xmlns:bri=\"http://www.opengis.net/citygml/bridge/2.0\"" << std::endl;
-  ss << "xmlns:app=\"http://www.opengis.net/citygml/appearance/2.0\"" << std::endl;
-  ss << "xmlns:tun=\"http://www.opengis.net/citygml/tunnel/2.0\"" << std::endl;
-  ss << "xmlns:cif=\"http://www.opengis.net/citygml/cityfurniture/2.0\"" << std::endl;
-  ss << "xmlns:imgeo=\"http://www.geostandaarden.nl/imgeo/2.1\"" << std::endl;
+  OutputBuffer ss;
+  ss << "<CityModel xmlns=\"http://www.opengis.net/citygml/2.0\"\n";
+  ss << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n";
+  ss << "xmlns:xAL=\"urn:oasis:names:tc:ciq:xsdschema:xAL:2.0\"\n";
+  ss << "xmlns:xlink=\"http://www.w3.org/1999/xlink\"\n";
+  ss << "xmlns:gml=\"http://www.opengis.net/gml\"\n";
+  ss << "xmlns:bui=\"http://www.opengis.net/citygml/building/2.0\"\n";
+  ss << "xmlns:wtr=\"http://www.opengis.net/citygml/waterbody/2.0\"\n";
+  ss << "xmlns:veg=\"http://www.opengis.net/citygml/vegetation/2.0\"\n";
+  ss << "xmlns:dem=\"http://www.opengis.net/citygml/relief/2.0\"\n";
+  ss << "xmlns:tra=\"http://www.opengis.net/citygml/transportation/2.0\"\n";
+  ss << "xmlns:lu=\"http://www.opengis.net/citygml/landuse/2.0\"\n";
+  ss << "xmlns:gen=\"http://www.opengis.net/citygml/generics/2.0\"\n";
+  ss << "xmlns:bri=\"http://www.opengis.net/citygml/bridge/2.0\"\n";
+  ss << "xmlns:app=\"http://www.opengis.net/citygml/appearance/2.0\"\n";
+  ss << "xmlns:tun=\"http://www.opengis.net/citygml/tunnel/2.0\"\n";
+  ss << "xmlns:cif=\"http://www.opengis.net/citygml/cityfurniture/2.0\"\n";
+  ss << "xmlns:imgeo=\"http://www.geostandaarden.nl/imgeo/2.1\"\n";
   ss << "xsi:schemaLocation=\"http://www.opengis.net/citygml/2.0 http://schemas.opengis.net/citygml/2.0/cityGMLBase.xsd http://www.geostandaarden.nl/imgeo/2.1 http://schemas.geonovum.nl/imgeo/2.1/imgeo-2.1.1.xsd\">";
   return ss.str();
 }
 
-std::string get_polygon_lifted_gml(Polygon2* p2, double height, bool reverse) {
-  std::stringstream ss;
-  ss << std::setprecision(3) << std::fixed;
-  if (reverse)
-    bg::reverse(*p2);
-  ss << "<gml:surfaceMember>" << std::endl;
-  ss << "<gml:Polygon>" << std::endl;
+//-- i-th vertex of the ring, counted from the end if reversed
+static const Point2& get_ring_point(const Ring2& r, int i, bool reverse) {
+  return reverse ? r[r.size() - 1 - i] : r[i];
+}
+
+void get_polygon_lifted_gml(OutputBuffer& ss, Polygon2* p2, double height, bool reverse) {
+  //-- the rings are read backwards when reversed, the polygon (shared by the threads
+  //-- writing the output) is not modified
+  ss << "<gml:surfaceMember>\n";
+  ss << "<gml:Polygon>\n";
   //-- oring  
-  auto r = bg::exterior_ring(*p2);
-  ss << "<gml:exterior>" << std::endl;
-  ss << "<gml:LinearRing>" << std::endl;
+  const Ring2& r = bg::exterior_ring(*p2);
+  ss << "<gml:exterior>\n";
+  ss << "<gml:LinearRing>\n";
   for (int i = 0; i < r.size(); i++)
-    ss << "<gml:pos>" << bg::get<0>(r[i]) << " " << bg::get<1>(r[i]) << " " << height << "</gml:pos>" << std::endl;
-  ss << "<gml:pos>" << bg::get<0>(r[0]) << " " << bg::get<1>(r[0]) << " " << height << "</gml:pos>" << std::endl;
-  ss << "</gml:LinearRing>" << std::endl;
-  ss << "</gml:exterior>" << std::endl;
+    ss << "<gml:pos>" << bg::get<0>(get_ring_point(r, i, reverse)) << " " << bg::get<1>(get_ring_point(r, i, reverse)) << " " << height << "</gml:pos>\n";
+  ss << "<gml:pos>" << bg::get<0>(get_ring_point(r, 0, reverse)) << " " << bg::get<1>(get_ring_point(r, 0, reverse)) << " " << height << "</gml:pos>\n";
+  ss << "</gml:LinearRing>\n";
+  ss << "</gml:exterior>\n";
   //-- irings
-  auto irings = bg::interior_rings(*p2);
-  for (Ring2& r : irings) {
-    ss << "<gml:interior>" << std::endl;
-    ss << "<gml:LinearRing>" << std::endl;
+  for (const Ring2& r : bg::interior_rings(*p2)) {
+    ss << "<gml:interior>\n";
+    ss << "<gml:LinearRing>\n";
     for (int i = 0; i < r.size(); i++)
-      ss << "<gml:pos>" << bg::get<0>(r[i]) << " " << bg::get<1>(r[i]) << " " << height << "</gml:pos>" << std::endl;
-    ss << "<gml:pos>" << bg::get<0>(r[0]) << " " << bg::get<1>(r[0]) << " " << height << "</gml:pos>" << std::endl;
-    ss << "</gml:LinearRing>" << std::endl;
-    ss << "</gml:interior>" << std::endl;
-  }
-  ss << "</gml:Polygon>" << std::endl;
-  ss << "</gml:surfaceMember>" << std::endl;
-  if (reverse)
-    bg::reverse(*p2);
-  return ss.str();
+      ss << "<gml:pos>" << bg::get<0>(get_ring_point(r, i, reverse)) << " " << bg::get<1>(get_ring_point(r, i, reverse)) << " " << height << "</gml:pos>\n";
+    ss << "<gml:pos>" << bg::get<0>(get_ring_point(r, 0, reverse)) << " " << bg::get<1>(get_ring_point(r, 0, reverse)) << " " << height << "</gml:pos>\n";
+    ss << "</gml:LinearRing>\n";
+    ss << "</gml:interior>\n";
+  }
+  ss << "</gml:Polygon>\n";
+  ss << "</gml:surfaceMember>\n";
 }
 
-std::string get_extruded_line_gml(Point2* a, Point2* b, double high, double low, bool reverse) {
-  std::stringstream ss;
-  ss << std::setprecision(3) << std::fixed;
-  ss << "<gml:surfaceMember>" << std::endl;
-  ss << "<gml:Polygon>" << std::endl;
-  ss << "<gml:exterior>" << std::endl;
-  ss << "<gml:LinearRing>" << std::endl;
-  ss << "<gml:pos>" << bg::get<0>(b) << " " << bg::get<1>(b) << " " << low << "</gml:pos>" << std::endl;
-  ss << "<gml:pos>" << bg::get<0>(a) << " " << bg::get<1>(a) << " " << low << "</gml:pos>" << std::endl;
-  ss << "<gml:pos>" << bg::get<0>(a) << " " << bg::get<1>(a) << " " << high << "</gml:pos>" << std::endl;
-  ss << "<gml:pos>" << bg::get<0>(b) << " " << bg::get<1>(b) << " " << high << "</gml:pos>" << std::endl;
-  ss << "<gml:pos>" << bg::get<0>(b) << " " << bg::get<1>(b) << " " << low << "</gml:pos>" << std::endl;
-  ss << "</gml:LinearRing>" << std::endl;
-  ss << "</gml:exterior>" << std::endl;
-  ss << "</gml:Polygon>" << std::endl;
-  ss << "</gml:surfaceMember>" << std::endl;
-  return ss.str();
+void get_extruded_line_gml(OutputBuffer& ss, Point2* a, Point2* b, double high, double low, bool reverse) {
+  ss << "<gml:surfaceMember>\n";
+  ss << "<gml:Polygon>\n";
+  ss << "<gml:exterior>\n";
+  ss << "<gml:LinearRing>\n";
+  ss << "<gml:pos>" << bg::get<0>(b) << " " << bg::get<1>(b) << " " << low << "</gml:pos>\n";
+  ss << "<gml:pos>" << bg::get<0>(a) << " " << bg::get<1>(a) << " " << low << "</gml:pos>\n";
+  ss << "<gml:pos>" << bg::get<0>(a) << " " << bg::get<1>(a) << " " << high << "</gml:pos>\n";
+  ss << "<gml:pos>" << bg::get<0>(b) << " " << bg::get<1>(b) << " " << high << "</gml:pos>\n";
+  ss << "<gml:pos>" << bg::get<0>(b) << " " << bg::get<1>(b) << " " << low << "</gml:pos>\n";
+  ss << "</gml:LinearRing>\n";
+  ss << "</gml:exterior>\n";
+  ss << "</gml:Polygon>\n";
+  ss << "</gml:surfaceMember>\n";
 }
 
-std::string get_extruded_lod1_block_gml(Polygon2* p2, double high, double low) {
-  std::stringstream ss;
+void get_extruded_lod1_block_gml(OutputBuffer& ss, Polygon2* p2, double high, double low) {
   //-- get floor
-  ss << get_polygon_lifted_gml(p2, low, false);
+  get_polygon_lifted_gml(ss, p2, low, false);
   //-- get roof
-  ss << get_polygon_lifted_gml(p2, high, true);
+  get_polygon_lifted_gml(ss, p2, high, true);
   //-- get the walls
   auto r = bg::exterior_ring(*p2);
   for (int i = 0; i < (r.size() - 1); i++)
-    ss << get_extruded_line_gml(&r[i], &r[i + 1], high, low, false);
-  return ss.str();
+    get_extruded_line_gml(ss, &r[i], &r[i + 1], high, low, false);
+}
+
+//-- the string quoted and escaped for JSON
+std::string get_json_string(const std::string &s) {
+  std::string r = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      r += '\\';
+      r += c;
+    }
+    else if (c == '\n')
+      r += "\\n";
+    else if (c == '\t')
+      r += "\\t";
+    else if (c == '\r')
+      r += "\\r";
+    else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+      r += buf;
+    }
+    else
+      r += c;
+  }
+  r += "\"";
+  return r;
 }
 
 bool is_string_integer(std::string s, int min, int max) {
@@ -173,6 +195,24 @@ bool is_string_integer(std::string s, int min, int max) {
   return true;
 }
 
+//-- the classes 3dfier distinguishes, the others are LAS_UNKNOWN
+LAS14Class get_las14class(int lasclass) {
+  switch (lasclass) {
+  case LAS_UNCLASSIFIED:
+    return LAS_UNCLASSIFIED;
+  case LAS_GROUND:
+    return LAS_GROUND;
+  case LAS_BUILDING:
+    return LAS_BUILDING;
+  case LAS_WATER:
+    return LAS_WATER;
+  case LAS_BRIDGE:
+    return LAS_BRIDGE;
+  default:
+    return LAS_UNKNOWN;
+  }
+}
+
 float z_to_float(int z) {
   return float(z) / 100;
 }
@@ -189,3 +229,244 @@ std::vector<std::string> stringsplit(std::string str, char delimiter) {
 
   return internal;
 }
+
+//-- chunk size stored in the LASzip VLR (user id "laszip encoded", record id 22204).
+//-- returns 0 if the points are not compressed in chunks of a fixed size.
+uint32_t get_laszip_chunk_size(liblas::Header const& header) {
+  for (auto& vlr : header.GetVLRs()) {
+    if (vlr.GetUserId(false) == "laszip encoded" && vlr.GetRecordId() == 22204) {
+      std::vector<uint8_t> const& data = vlr.GetData();
+      if (data.size() < 16)
+        return 0;
+      uint16_t compressor = uint16_t(data[0] | (data[1] << 8));
+      uint32_t chunksize = uint32_t(data[12]) | (uint32_t(data[13]) << 8) | (uint32_t(data[14]) << 16) | (uint32_t(data[15]) << 24);
+      //-- 2 = pointwise chunked, 3 = layered chunked; variable chunks have size 0xFFFFFFFF
+      if ((compressor != 2 && compressor != 3) || chunksize == 0xFFFFFFFF)
+        return 0;
+      return chunksize;
+    }
+  }
+  return 0;
+}
+
+//-- extent of a LAS/LAZ file from its header, without reading its points
+bool get_las_extent(std::string lasfile, Box2 &extent) {
+  std::ifstream ifs;
+  ifs.open(lasfile.c_str(), std::ios::in | std::ios::binary);
+  if (ifs.is_open() == false)
+    return false;
+  try {
+    liblas::ReaderFactory f;
+    liblas::Reader reader = f.CreateWithStream(ifs);
+    liblas::Bounds<double> bounds = reader.GetHeader().GetExtent();
+    extent = Box2(Point2(bounds.minx(), bounds.miny()), Point2(bounds.maxx(), bounds.maxy()));
+  }
+  catch (const std::exception& e) {
+    ifs.close();
+    return false;
+  }
+  ifs.close();
+  return true;
+}
+
+//-- index of a LAS/LAZ file: the bounds of each interval of points, stored in the directory
+//-- given with options.las_index_dir. It is only valid for the same size and modification
+//-- time of the file, and the same interval size.
+#define LAS_INDEX_MAGIC "3DFIDX01"
+
+//-- <name of the file>_<hash of its absolute path>.3dfidx, files with the same name in
+//-- different directories thus have different indexes
+std::string get_las_index_filename(std::string dir, std::string lasfile) {
+  boost::filesystem::path p(lasfile);
+  std::stringstream ss;
+  ss << p.filename().string() << "_" << std::hex << std::hash<std::string>()(boost::filesystem::absolute(p).string()) << ".3dfidx";
+  return (boost::filesystem::path(dir) / ss.str()).string();
+}
+
+bool read_las_index(std::string indexfile, std::string lasfile, uint32_t pointcount, uint32_t step, std::vector<Box2> &bounds) {
+  std::ifstream ifs(indexfile.c_str(), std::ios::in | std::ios::binary);
+  if (ifs.is_open() == false)
+    return false;
+  char magic[8];
+  uint64_t filesize;
+  int64_t mtime;
+  uint32_t count, istep, n;
+  ifs.read(magic, 8);
+  ifs.read((char*)&filesize, sizeof(filesize));
+  ifs.read((char*)&mtime, sizeof(mtime));
+  ifs.read((char*)&count, sizeof(count));
+  ifs.read((char*)&istep, sizeof(istep));
+  ifs.read((char*)&n, sizeof(n));
+  if (!ifs || std::string(magic, 8) != LAS_INDEX_MAGIC || count != pointcount || istep != step)
+    return false;
+  try {
+    if (filesize != uint64_t(boost::filesystem::file_size(lasfile)) || mtime != int64_t(boost::filesystem::last_write_time(lasfile)))
+      return false;
+  }
+  catch (boost::filesystem::filesystem_error &e) {
+    return false;
+  }
+  bounds.resize(n);
+  for (uint32_t i = 0; i < n; i++) {
+    double b[4];
+    ifs.read((char*)b, sizeof(b));
+    bounds[i] = Box2(Point2(b[0], b[1]), Point2(b[2], b[3]));
+  }
+  if (!ifs) {
+    bounds.clear();
+    return false;
+  }
+  return true;
+}
+
+bool write_las_index(std::string indexfile, std::string lasfile, uint32_t pointcount, uint32_t step, std::vector<Box2> const& bounds) {
+  uint64_t filesize;
+  int64_t mtime;
+  try {
+    filesize = uint64_t(boost::filesystem::file_size(lasfile));
+    mtime = int64_t(boost::filesystem::last_write_time(lasfile));
+  }
+  catch (boost::filesystem::filesystem_error &e) {
+    return false;
+  }
+  std::ofstream ofs(indexfile.c_str(), std::ios::out | std::ios::binary);
+  if (ofs.is_open() == false)
+    return false;
+  uint32_t n = uint32_t(bounds.size());
+  ofs.write(LAS_INDEX_MAGIC, 8);
+  ofs.write((char*)&filesize, sizeof(filesize));
+  ofs.write((char*)&mtime, sizeof(mtime));
+  ofs.write((char*)&pointcount, sizeof(pointcount));
+  ofs.write((char*)&step, sizeof(step));
+  ofs.write((char*)&n, sizeof(n));
+  for (auto& box : bounds) {
+    double b[4] = { bg::get<bg::min_corner, 0>(box), bg::get<bg::min_corner, 1>(box),
+                    bg::get<bg::max_corner, 0>(box), bg::get<bg::max_corner, 1>(box) };
+    ofs.write((char*)b, sizeof(b));
+  }
+  return bool(ofs);
+}
+
+//-- spatial index of LAStools (lasindex) next to the file: <file without extension>.lax.
+//-- It is a quadtree (LASS) whose cells (LASV) list the ranges of points [start, end] in
+//-- them; the bounds of an interval of points of 3dfier are those of the cells overlapping
+//-- it. https://github.com/LAStools/LAStools/blob/master/LASlib/src/lasindex.cpp
+static bool read_lax_uint32(std::ifstream &ifs, uint32_t &v) {
+  unsigned char b[4];
+  ifs.read((char*)b, 4);
+  v = uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24);
+  return bool(ifs);
+}
+
+static bool read_lax_float(std::ifstream &ifs, float &v) {
+  uint32_t u;
+  if (read_lax_uint32(ifs, u) == false)
+    return false;
+  std::memcpy(&v, &u, sizeof(v));
+  return true;
+}
+
+bool read_lax_index(std::string lasfile, uint32_t pointcount, uint32_t step, std::vector<Box2> &bounds) {
+  std::string laxfile = boost::filesystem::path(lasfile).replace_extension(".lax").string();
+  std::ifstream ifs(laxfile.c_str(), std::ios::in | std::ios::binary);
+  if (ifs.is_open() == false)
+    return false;
+  char signature[4];
+  uint32_t version, type, size, levels, levelindex, implicitlevels;
+  float qminx, qmaxx, qminy, qmaxy;
+  ifs.read(signature, 4);
+  if (!ifs || std::string(signature, 4) != "LASX" || read_lax_uint32(ifs, version) == false)
+    return false;
+  ifs.read(signature, 4);
+  if (!ifs || std::string(signature, 4) != "LASS")
+    return false;
+  //-- only the quadtree (type 0) exists
+  if (read_lax_uint32(ifs, type) == false || type != 0 ||
+    read_lax_uint32(ifs, size) == false || read_lax_uint32(ifs, version) == false ||
+    read_lax_uint32(ifs, levels) == false || read_lax_uint32(ifs, levelindex) == false ||
+    read_lax_uint32(ifs, implicitlevels) == false ||
+    read_lax_float(ifs, qminx) == false || read_lax_float(ifs, qmaxx) == false ||
+    read_lax_float(ifs, qminy) == false || read_lax_float(ifs, qmaxy) == false)
+    return false;
+  if (levels > 16)
+    return false;
+  ifs.read(signature, 4);
+  uint32_t ncells;
+  if (!ifs || std::string(signature, 4) != "LASV" || read_lax_uint32(ifs, version) == false || read_lax_uint32(ifs, ncells) == false)
+    return false;
+  //-- the first cell of each level: 0, 1, 5, 21, ...
+  std::vector<uint64_t> leveloffset(1, 0);
+  for (uint32_t l = 0; l <= levels; l++)
+    leveloffset.push_back(leveloffset.back() + (uint64_t(1) << (2 * l)));
+  //-- the coordinates are floats in the file, the cells are enlarged to not miss points
+  double tolerance = std::max(double(qmaxx) - qminx, double(qmaxy) - qminy) * 1e-6 + 1e-3;
+  std::size_t n = std::size_t((uint64_t(pointcount) + step - 1) / step);
+  std::vector<bool> covered(n, false);
+  bounds.assign(n, Box2());
+  for (uint32_t c = 0; c < ncells; c++) {
+    uint32_t cellindex, nintervals, npoints;
+    if (read_lax_uint32(ifs, cellindex) == false || read_lax_uint32(ifs, nintervals) == false || read_lax_uint32(ifs, npoints) == false)
+      return false;
+    uint32_t level = 0;
+    while (level < levels && cellindex >= leveloffset[level + 1])
+      level++;
+    uint64_t levelcell = cellindex - leveloffset[level];
+    double cminx = qminx, cmaxx = qmaxx, cminy = qminy, cmaxy = qmaxy;
+    for (uint32_t l = level; l > 0; l--) {
+      uint64_t quadrant = (levelcell >> (2 * (l - 1))) & 3;
+      double midx = (cminx + cmaxx) / 2;
+      double midy = (cminy + cmaxy) / 2;
+      if (quadrant & 1)
+        cminx = midx;
+      else
+        cmaxx = midx;
+      if (quadrant & 2)
+        cminy = midy;
+      else
+        cmaxy = midy;
+    }
+    Box2 cell(Point2(cminx - tolerance, cminy - tolerance), Point2(cmaxx + tolerance, cmaxy + tolerance));
+    for (uint32_t i = 0; i < nintervals; i++) {
+      uint32_t start, end;
+      if (read_lax_uint32(ifs, start) == false || read_lax_uint32(ifs, end) == false)
+        return false;
+      if (start > end || end >= pointcount)
+        return false;
+      for (std::size_t ii = start / step; ii <= end / step; ii++) {
+        if (covered[ii])
+          bg::expand(bounds[ii], cell);
+        else
+          bounds[ii] = cell;
+        covered[ii] = true;
+      }
+    }
+  }
+  //-- an interval without cells has no known bounds, the index cannot be used
+  for (std::size_t ii = 0; ii < n; ii++) {
+    if (covered[ii] == false) {
+      bounds.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void write_binary_uint8(std::ostream &out, uint8_t v) {
+  out.put(char(v));
+}
+
+void write_binary_uint16(std::ostream &out, uint16_t v) {
+  char b[2] = { char(v & 0xff), char((v >> 8) & 0xff) };
+  out.write(b, 2);
+}
+
+void write_binary_uint32(std::ostream &out, uint32_t v) {
+  char b[4] = { char(v & 0xff), char((v >> 8) & 0xff), char((v >> 16) & 0xff), char((v >> 24) & 0xff) };
+  out.write(b, 4);
+}
+
+void write_binary_float(std::ostream &out, float v) {
+  uint32_t u;
+  std::memcpy(&u, &v, sizeof(u));
+  write_binary_uint32(out, u);
+}
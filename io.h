@@ -31,18 +31,33 @@
 
 #include "definitions.h"
 #include "TopoFeature.h"
+#include "OutputBuffer.h"
 
 void printProgressBar(int percent);
 std::string get_xml_header();
 std::string get_citygml_namespaces();
 std::string get_citygml_imgeo_namespaces();
 
-std::string get_polygon_lifted_gml(Polygon2* p2, double height, bool reverse = false);
-std::string get_extruded_line_gml(Point2* a, Point2* b, double high, double low, bool reverse = false);
-std::string get_extruded_lod1_block_gml(Polygon2* p2, double high, double low = 0.0);
+void get_polygon_lifted_gml(OutputBuffer& ss, Polygon2* p2, double height, bool reverse = false);
+void get_extruded_line_gml(OutputBuffer& ss, Point2* a, Point2* b, double high, double low, bool reverse = false);
+void get_extruded_lod1_block_gml(OutputBuffer& ss, Polygon2* p2, double high, double low = 0.0);
+std::string get_json_string(const std::string &s);
 
 bool  is_string_integer(std::string s, int min = 0, int max = 1e6);
 float z_to_float(int z);
+LAS14Class get_las14class(int lasclass);
+uint32_t get_laszip_chunk_size(liblas::Header const& header);
+bool get_las_extent(std::string lasfile, Box2 &extent);
+std::string get_las_index_filename(std::string dir, std::string lasfile);
+bool read_las_index(std::string indexfile, std::string lasfile, uint32_t pointcount, uint32_t step, std::vector<Box2> &bounds);
+bool write_las_index(std::string indexfile, std::string lasfile, uint32_t pointcount, uint32_t step, std::vector<Box2> const& bounds);
+bool read_lax_index(std::string lasfile, uint32_t pointcount, uint32_t step, std::vector<Box2> &bounds);
 std::vector<std::string> stringsplit(std::string str, char delimiter);
 
+//-- little-endian binary values, for the PLY and STL output
+void write_binary_uint8(std::ostream &out, uint8_t v);
+void write_binary_uint16(std::ostream &out, uint16_t v);
+void write_binary_uint32(std::ostream &out, uint32_t v);
+void write_binary_float(std::ostream &out, float v);
+
 #endif
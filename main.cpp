@@ -27,7 +27,6 @@
 */
 
 //-- TODO: create the topo DS locally? to prevent cases where nodes on only in one polygon. Or pprepair before?
-//-- TODO: write output all polygons once the tile completely containing is closed?
 //-- TODO : how to make roads horizontal "in the width"? 
 
 //-----------------------------------------------------------------------------
@@ -184,6 +183,35 @@ int main(int argc, const char * argv[]) {
     if (n["stitching"].as<std::string>() == "false")
       bStitching = false;
   }
+  if (n["threads"])
+    map3d.set_threads(n["threads"].as<int>());
+  if (n["max_concurrent_files"])
+    map3d.set_max_concurrent_files(n["max_concurrent_files"].as<int>());
+  if (n["feature_index"] && n["feature_index"].as<std::string>() == "grid")
+    map3d.set_use_feature_grid(true);
+  if (n["las_index"] && n["las_index"].as<std::string>() == "false")
+    map3d.set_use_las_index(false);
+  if (n["las_index_dir"])
+    map3d.set_las_index_dir(n["las_index_dir"].as<std::string>());
+  if (n["shared_nodes"] && n["shared_nodes"].as<std::string>() == "false")
+    map3d.set_use_shared_nodes(false);
+  if (n["parallel_stitching"] && n["parallel_stitching"].as<std::string>() == "true")
+    map3d.set_parallel_stitching(true);
+  if (n["point_cache"])
+    map3d.set_point_cache(n["point_cache"].as<std::string>());
+  if (n["elevation_accumulator"] && n["elevation_accumulator"].as<std::string>() == "histogram") {
+    int bins = 128;
+    if (n["elevation_accumulator_bins"])
+      bins = n["elevation_accumulator_bins"].as<int>();
+    map3d.set_elevation_accumulator(true, bins);
+  }
+  double tilesize = 0;
+  double tilebuffer = 100;
+  if (n["tile_size"])
+    tilesize = n["tile_size"].as<double>();
+  if (n["tile_buffer"])
+    tilebuffer = n["tile_buffer"].as<double>();
+  Box2 requestedextent;
   if (n["extent"]) {
     std::vector<std::string> extent_split = stringsplit(n["extent"].as<std::string>(), ',');
     double xmin, xmax, ymin, ymax;
@@ -206,6 +234,7 @@ int main(int argc, const char * argv[]) {
     {
       std::clog << "Using extent for polygons: (" << n["extent"].as<std::string>() << ")" << std::endl;
       map3d.set_requested_extent(xmin, ymin, xmax, ymax);
+      requestedextent = Box2(Point2(xmin, ymin), Point2(xmax, ymax));
     }
   }
 
@@ -251,28 +280,9 @@ int main(int argc, const char * argv[]) {
     }
   }
 
-  bool added = map3d.add_polygons_files(files);
-  if (!added) {
-    std::cerr << "ERROR: Missing polygon data, cannot 3dfy the dataset. Aborting." << std::endl;
-    return 0;
-  }
-  std::clog << "\nTotal # of polygons: " << boost::locale::as::number << map3d.get_num_polygons() << std::endl;
-
-  //-- spatially index the polygons
-  map3d.construct_rtree();
-
-  //-- print bbox from _rtree
-  Box2 b = map3d.get_bbox();
-  std::clog << std::setprecision(3) << std::fixed;
-  std::clog << "Spatial extent: ("
-    << bg::get<bg::min_corner, 0>(b) << ", "
-    << bg::get<bg::min_corner, 1>(b) << ") ("
-    << bg::get<bg::max_corner, 0>(b) << ", "
-    << bg::get<bg::max_corner, 1>(b) << ")" << std::endl;
-  
   //-- add elevation datasets
   n = nodes["input_elevation"];
-  bool bElevData = false;
+  std::vector<PointFile> elevationfiles;
   for (auto it = n.begin(); it != n.end(); ++it) {
     YAML::Node tmp = (*it)["omit_LAS_classes"];
     std::vector<int> lasomits;
@@ -280,9 +290,11 @@ int main(int argc, const char * argv[]) {
       lasomits.push_back(it2->as<int>());
     tmp = (*it)["datasets"];
     for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
-      int thinning = 1;
+      PointFile file;
+      file.lasomits = lasomits;
+      file.thinning = 1;
       if ((*it)["thinning"]) {
-        thinning = (*it)["thinning"].as<int>();
+        file.thinning = (*it)["thinning"].as<int>();
       }
 
       //-- iterate over all files in directory
@@ -291,99 +303,220 @@ int main(int argc, const char * argv[]) {
       if (path.stem() == "*") {
         if (!boost::filesystem::exists(rootPath) || !boost::filesystem::is_directory(rootPath)) {
           std::cerr << "\tERROR: " << rootPath << "is not a directory, skipping it." << std::endl;
-          bElevData = false;
           break;
         }
         else {
           boost::filesystem::recursive_directory_iterator it_end;
           for (boost::filesystem::recursive_directory_iterator it(rootPath); it != it_end; ++it) {
             if (boost::filesystem::is_regular_file(*it) && it->path().extension() == path.extension()) {
-              bool added = map3d.add_las_file(it->path().string(), lasomits, thinning);
-              if (!added) {
-                bElevData = false;
-                break;
-              }
-              else {
-                bElevData = true;
-              }
+              file.filename = it->path().string();
+              elevationfiles.push_back(file);
             }
           }
         }
       }
       else {
-        bool added = map3d.add_las_file(path.string(), lasomits, thinning);
-        if (!added) {
-          bElevData = false;
-          break;
-        }
-        else {
-          bElevData = true;
-        }
+        file.filename = path.string();
+        elevationfiles.push_back(file);
       }
     }
   }
-  if (bElevData == false) {
-    std::cerr << "ERROR: Missing elevation data, cannot 3dfy the dataset. Aborting." << std::endl;
-     return 0;
-  }
-
   n = nodes["output"];
   std::string format = n["format"].as<std::string>();
-  std::clog << "Lifting all input polygons to 3D..." << std::endl;
-  if (format == "CSV-BUILDINGS")
-    map3d.threeDfy(false);
-  else if (format == "OBJ-BUILDINGS") {
-    map3d.threeDfy(false);
-    map3d.construct_CDT();
-  }
-  else {
-    map3d.threeDfy(bStitching);
-    map3d.construct_CDT();
-  }
-  std::clog << "done." << std::endl;
-
-
-  //-- output
   if (n["building_floor"].as<std::string>() == "true")
     map3d.set_building_include_floor(true);
   int z_exaggeration = 0;
   if (n["vertical_exaggeration"])
     z_exaggeration = n["vertical_exaggeration"].as<int>();
+  double tilesettilesize = 250;
+  if (n["tileset_tile_size"])
+    tilesettilesize = n["tileset_tile_size"].as<double>();
+  int epsg = 0;
+  if (n["epsg"])
+    epsg = n["epsg"].as<int>();
+
+  //-- the tiles: the polygons of a tile are processed with those in a buffer around it,
+  //-- so that its features are stitched with all their neighbours, and only the features
+  //-- of the tile are written. Without tiling there is one tile with everything.
+  Box2 extent;
+  std::vector<Box2> tiles;
+  std::vector<Box2> tilebuffers;
+  std::vector<Box2> elevationextents;
+  std::size_t tilesperrow = 1;
+  if (tilesize > 0) {
+    if (map3d.get_polygons_extent(files, extent) == false) {
+      std::cerr << "ERROR: Missing polygon data, cannot 3dfy the dataset. Aborting." << std::endl;
+      return 0;
+    }
+    if (bg::area(requestedextent) > 0 && bg::intersection(extent, requestedextent, extent) == false) {
+      std::cerr << "ERROR: The supplied extent does not overlap the polygons. Aborting." << std::endl;
+      return 0;
+    }
+    double xmin = bg::get<bg::min_corner, 0>(extent);
+    double ymin = bg::get<bg::min_corner, 1>(extent);
+    double xmax = bg::get<bg::max_corner, 0>(extent);
+    double ymax = bg::get<bg::max_corner, 1>(extent);
+    int ntx = std::max(1, int(std::ceil((xmax - xmin) / tilesize)));
+    int nty = std::max(1, int(std::ceil((ymax - ymin) / tilesize)));
+    tilesperrow = std::size_t(ntx);
+    double unbounded = std::numeric_limits<double>::max();
+    for (int ty = 0; ty < nty; ty++) {
+      for (int tx = 0; tx < ntx; tx++) {
+        double tminx = xmin + tx * tilesize;
+        double tminy = ymin + ty * tilesize;
+        double tmaxx = std::min(tminx + tilesize, xmax);
+        double tmaxy = std::min(tminy + tilesize, ymax);
+        Box2 buffer(Point2(tminx - tilebuffer, tminy - tilebuffer), Point2(tmaxx + tilebuffer, tmaxy + tilebuffer));
+        if (bg::area(requestedextent) > 0)
+          bg::intersection(buffer, requestedextent, buffer);
+        tilebuffers.push_back(buffer);
+        tiles.push_back(Box2(Point2((tx == 0) ? -unbounded : tminx, (ty == 0) ? -unbounded : tminy),
+          Point2((tx == ntx - 1) ? unbounded : tmaxx, (ty == nty - 1) ? unbounded : tmaxy)));
+      }
+    }
+    std::clog << "Tiling: " << ntx << "x" << nty << " tiles of " << tilesize << " m with a buffer of " << tilebuffer << " m" << std::endl;
+    //-- the extent of the elevation files, read once, to only give each tile those overlapping it
+    for (auto& file : elevationfiles) {
+      Box2 lasextent;
+      if (get_las_extent(file.filename, lasextent) == false) {
+        //-- unknown extent: the file is given to all the tiles and its errors are reported then
+        double unbounded = std::numeric_limits<double>::max();
+        lasextent = Box2(Point2(-unbounded, -unbounded), Point2(unbounded, unbounded));
+      }
+      elevationextents.push_back(lasextent);
+    }
+  }
+  else
+    tiles.push_back(Box2());
 
   std::ofstream outputfile;
-  if (format != "Shapefile")
+  if (format == "PLY" || format == "STL")
+    outputfile.open(outputFilename, std::ios::binary);
+  else if (format != "Shapefile")
     outputfile.open(outputFilename);
 
-  if (format == "CityGML") {
-    std::clog << "CityGML output" << std::endl;
-    map3d.get_citygml(outputfile);
-  }
-  else if (format == "CityGML-IMGeo") {
-    std::clog << "CityGML-IMGeo output" << std::endl;
-    map3d.get_citygml_imgeo(outputfile);
-  }
-  else if (format == "OBJ") {
-    std::clog << "OBJ output" << std::endl;
-    map3d.get_obj_per_feature(outputfile, z_exaggeration);
-  }
-  else if (format == "OBJ-NoID") {
-    std::clog << "OBJ (without IDs) output" << std::endl;
-    map3d.get_obj_per_class(outputfile, z_exaggeration);
-  }
-  else if (format == "CSV-BUILDINGS") {
-    std::clog << "CSV output (only of the buildings)" << std::endl;
-    map3d.get_csv_buildings(outputfile);
-  }
-  else if (format == "Shapefile") {
-    std::clog << "Shapefile output" << std::endl;
-    if (map3d.get_shapefile(outputFilename)) {
-      std::clog << "Shapefile written" << std::endl;
+  for (std::size_t t = 0; t < tiles.size(); t++) {
+    if (tilesize > 0) {
+      std::clog << "\n===== TILE " << (t + 1) << "/" << tiles.size() << " =====" << std::endl;
+      map3d.clear_features();
+      map3d.set_requested_extent(bg::get<bg::min_corner, 0>(tilebuffers[t]), bg::get<bg::min_corner, 1>(tilebuffers[t]),
+        bg::get<bg::max_corner, 0>(tilebuffers[t]), bg::get<bg::max_corner, 1>(tilebuffers[t]));
     }
-    else
-    {
-      std::cerr << "Writing shapefile failed" << std::endl;
+    bool added = map3d.add_polygons_files(files);
+    if (!added) {
+      std::cerr << "ERROR: Missing polygon data, cannot 3dfy the dataset. Aborting." << std::endl;
       return 0;
     }
+    std::clog << "\nTotal # of polygons: " << boost::locale::as::number << map3d.get_num_polygons() << std::endl;
+
+    if (tilesize == 0 || map3d.get_num_polygons() > 0) {
+      //-- spatially index the polygons
+      map3d.construct_rtree();
+
+      //-- print bbox from _rtree
+      Box2 b = map3d.get_bbox();
+      std::clog << std::setprecision(3) << std::fixed;
+      std::clog << "Spatial extent: ("
+        << bg::get<bg::min_corner, 0>(b) << ", "
+        << bg::get<bg::min_corner, 1>(b) << ") ("
+        << bg::get<bg::max_corner, 0>(b) << ", "
+        << bg::get<bg::max_corner, 1>(b) << ")" << std::endl;
+
+      //-- the files are read concurrently, all feeding the same features
+      bool bElevData = false;
+      if (tilesize > 0 && elevationfiles.empty() == false) {
+        std::vector<PointFile> tilefiles;
+        for (std::size_t i = 0; i < elevationfiles.size(); i++) {
+          if (bg::intersects(elevationextents[i], tilebuffers[t]))
+            tilefiles.push_back(elevationfiles[i]);
+        }
+        std::clog << "Elevation files overlapping the tile: " << tilefiles.size() << "/" << elevationfiles.size() << std::endl;
+        bElevData = tilefiles.empty() || map3d.add_las_files(tilefiles);
+      }
+      else if (elevationfiles.empty() == false) {
+        bElevData = map3d.add_las_files(elevationfiles);
+      }
+      if (bElevData == false) {
+        std::cerr << "ERROR: Missing elevation data, cannot 3dfy the dataset. Aborting." << std::endl;
+         return 0;
+      }
+
+      std::clog << "Lifting all input polygons to 3D..." << std::endl;
+      if (format == "CSV-BUILDINGS")
+        map3d.threeDfy(false);
+      else if (format == "OBJ-BUILDINGS") {
+        map3d.threeDfy(false);
+        map3d.construct_CDT();
+      }
+      else {
+        map3d.threeDfy(bStitching);
+        map3d.construct_CDT();
+      }
+      std::clog << "done." << std::endl;
+    }
+
+    //-- output
+    if (tilesize > 0) {
+      map3d.set_output_tile(tiles[t], extent, t == 0, t == tiles.size() - 1);
+      map3d.save_decided_heights(t, tilesperrow);
+    }
+
+    if (format == "CityGML") {
+      std::clog << "CityGML output" << std::endl;
+      map3d.get_citygml(outputfile);
+    }
+    else if (format == "CityGML-IMGeo") {
+      std::clog << "CityGML-IMGeo output" << std::endl;
+      map3d.get_citygml_imgeo(outputfile);
+    }
+    else if (format == "OBJ") {
+      std::clog << "OBJ output" << std::endl;
+      map3d.get_obj_per_feature(outputfile, z_exaggeration);
+    }
+    else if (format == "OBJ-NoID") {
+      std::clog << "OBJ (without IDs) output" << std::endl;
+      map3d.get_obj_per_class(outputfile, z_exaggeration);
+    }
+    else if (format == "CityJSON") {
+      std::clog << "CityJSON output" << std::endl;
+      map3d.get_cityjson(outputfile);
+    }
+    else if (format == "3DTiles") {
+      std::clog << "3D Tiles output" << std::endl;
+      if (map3d.get_3dtiles(outputfile, outputFilename, tilesettilesize, epsg) == false) {
+        std::cerr << "Writing 3D Tiles failed" << std::endl;
+        return 0;
+      }
+    }
+    else if (format == "PLY") {
+      std::clog << "PLY output" << std::endl;
+      if (map3d.get_ply(outputfile) == false) {
+        std::cerr << "Writing PLY failed" << std::endl;
+        return 0;
+      }
+    }
+    else if (format == "STL") {
+      std::clog << "STL output" << std::endl;
+      if (map3d.get_stl(outputfile) == false) {
+        std::cerr << "Writing STL failed" << std::endl;
+        return 0;
+      }
+    }
+    else if (format == "CSV-BUILDINGS") {
+      std::clog << "CSV output (only of the buildings)" << std::endl;
+      map3d.get_csv_buildings(outputfile);
+    }
+    else if (format == "Shapefile") {
+      std::clog << "Shapefile output" << std::endl;
+      if (map3d.get_shapefile(outputFilename)) {
+        std::clog << "Shapefile written" << std::endl;
+      }
+      else
+      {
+        std::cerr << "Writing shapefile failed" << std::endl;
+        return 0;
+      }
+    }
   }
   outputfile.close();
 
@@ -590,18 +723,111 @@ bool validate_yaml(const char* arg, std::set<std::string>& allowedFeatures) {
       std::cerr << "\tOption 'options.threshold_jump_edges' invalid." << std::endl;
     }
   }
+  if (n["threads"]) {
+    if (is_string_integer(n["threads"].as<std::string>(), 0, 1024) == false) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.threads' invalid; must be an integer (0 = all cores)." << std::endl;
+    }
+  }
+  if (n["max_concurrent_files"]) {
+    if (is_string_integer(n["max_concurrent_files"].as<std::string>(), 1, 1024) == false) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.max_concurrent_files' invalid; must be a positive integer." << std::endl;
+    }
+  }
+  if (n["las_index_dir"]) {
+    boost::filesystem::path indexdir(n["las_index_dir"].as<std::string>());
+    if (!boost::filesystem::exists(indexdir) || !boost::filesystem::is_directory(indexdir)) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.las_index_dir' invalid; must be an existing directory." << std::endl;
+    }
+  }
+  if (n["point_cache"]) {
+    boost::filesystem::path cachedir(n["point_cache"].as<std::string>());
+    if (!boost::filesystem::exists(cachedir) || !boost::filesystem::is_directory(cachedir)) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.point_cache' invalid; must be an existing directory." << std::endl;
+    }
+  }
+  if (n["elevation_accumulator"]) {
+    std::string accumulator = n["elevation_accumulator"].as<std::string>();
+    if ((accumulator != "exact") && (accumulator != "histogram")) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.elevation_accumulator' invalid; must be 'exact' or 'histogram'." << std::endl;
+    }
+  }
+  if (n["elevation_accumulator_bins"]) {
+    if (is_string_integer(n["elevation_accumulator_bins"].as<std::string>(), 2, 65536) == false) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.elevation_accumulator_bins' invalid; must be an integer of at least 2." << std::endl;
+    }
+  }
+  if (n["feature_index"]) {
+    std::string index = n["feature_index"].as<std::string>();
+    if ((index != "rtree") && (index != "grid")) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.feature_index' invalid; must be 'rtree' or 'grid'." << std::endl;
+    }
+  }
+  if (n["tile_size"]) {
+    try {
+      if (boost::lexical_cast<double>(n["tile_size"].as<std::string>()) < 0)
+        throw boost::bad_lexical_cast();
+    }
+    catch (boost::bad_lexical_cast& e) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.tile_size' invalid; must be a size in meters (0 = no tiling)." << std::endl;
+    }
+  }
+  if (n["tile_buffer"]) {
+    try {
+      if (boost::lexical_cast<double>(n["tile_buffer"].as<std::string>()) < 0)
+        throw boost::bad_lexical_cast();
+    }
+    catch (boost::bad_lexical_cast& e) {
+      wentgood = false;
+      std::cerr << "\tOption 'options.tile_buffer' invalid; must be a distance in meters." << std::endl;
+    }
+  }
+  bool tiled = (n["tile_size"] && n["tile_size"].as<std::string>() != "0");
   //-- 5. output
   n = nodes["output"];
   std::string format = n["format"].as<std::string>();
+  if (tiled && (format != "CityGML") && (format != "CityGML-IMGeo") && (format != "CSV-BUILDINGS")) {
+    wentgood = false;
+    std::cerr << "\tOption 'options.tile_size' can only be used with the output formats CityGML, CityGML-IMGeo and CSV-BUILDINGS" << std::endl;
+  }
   if ((format != "OBJ") &&
     (format != "OBJ-NoID") &&
     (format != "CityGML") &&
     (format != "CityGML-IMGeo") &&
     (format != "OBJ-BUILDINGS") &&
     (format != "CSV-BUILDINGS") &&
+    (format != "CityJSON") &&
+    (format != "3DTiles") &&
+    (format != "PLY") &&
+    (format != "STL") &&
     (format != "Shapefile")) {
     wentgood = false;
-    std::cerr << "\tOption 'output.format' invalid (OBJ | OBJ-NoID | CityGML | CityGML-IMGeo | CSV-BUILDINGS | Shapefile)" << std::endl;
+    std::cerr << "\tOption 'output.format' invalid (OBJ | OBJ-NoID | CityGML | CityGML-IMGeo | CityJSON | 3DTiles | CSV-BUILDINGS | PLY | STL | Shapefile)" << std::endl;
+  }
+  if (format == "3DTiles" && !n["epsg"]) {
+    wentgood = false;
+    std::cerr << "\tOption 'output.epsg' missing; the 3DTiles output needs the EPSG code of the coordinates of the input." << std::endl;
+  }
+  if (n["epsg"] && is_string_integer(n["epsg"].as<std::string>(), 1, 999999) == false) {
+    wentgood = false;
+    std::cerr << "\tOption 'output.epsg' invalid; must be an EPSG code." << std::endl;
+  }
+  if (n["tileset_tile_size"]) {
+    try {
+      if (boost::lexical_cast<double>(n["tileset_tile_size"].as<std::string>()) <= 0)
+        throw boost::bad_lexical_cast();
+    }
+    catch (boost::bad_lexical_cast& e) {
+      wentgood = false;
+      std::cerr << "\tOption 'output.tileset_tile_size' invalid; must be a size in meters larger than 0." << std::endl;
+    }
   }
   return wentgood;
 }
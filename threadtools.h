@@ -0,0 +1,118 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2017  3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef threadtools_h
+#define threadtools_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+//-- number of threads to use when none is configured
+inline int get_default_number_threads() {
+  int n = int(std::thread::hardware_concurrency());
+  return (n > 0) ? n : 1;
+}
+
+//-- calls f(i, t) for each i in [0, n) on nthreads threads, t is the index of the thread
+//-- (for per-thread buffers). The indices are handed out one at a time, so a few
+//-- expensive items do not leave the other threads idle.
+template <typename F>
+void parallel_for_indexed(std::size_t n, int nthreads, F f) {
+  if (nthreads <= 1 || n <= 1) {
+    for (std::size_t i = 0; i < n; i++)
+      f(i, 0);
+    return;
+  }
+  std::atomic<std::size_t> next(0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads && std::size_t(t) < n; t++) {
+    workers.push_back(std::thread([&next, n, &f, t] {
+      for (std::size_t i = next++; i < n; i = next++)
+        f(i, t);
+    }));
+  }
+  for (auto& w : workers)
+    w.join();
+}
+
+//-- calls f(i) for each i in [0, n) on nthreads threads
+template <typename F>
+void parallel_for(std::size_t n, int nthreads, F f) {
+  parallel_for_indexed(n, nthreads, [&f](std::size_t i, int t) { f(i); });
+}
+
+//-- bounded FIFO queue between producer and consumer threads.
+//-- push() blocks while the queue is full, pop() blocks while it is empty.
+//-- once close() is called pop() drains what is left and then returns false.
+template <typename T>
+class BlockingQueue {
+public:
+  BlockingQueue(std::size_t capacity) : _capacity(capacity), _closed(false) {}
+
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notfull.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+    if (_closed)
+      return false;
+    _items.push_back(std::move(item));
+    _notempty.notify_one();
+    return true;
+  }
+
+  bool pop(T& item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notempty.wait(lock, [this] { return _closed || _items.empty() == false; });
+    if (_items.empty())
+      return false;
+    item = std::move(_items.front());
+    _items.pop_front();
+    _notfull.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _notempty.notify_all();
+    _notfull.notify_all();
+  }
+
+private:
+  std::size_t             _capacity;
+  bool                    _closed;
+  std::deque<T>           _items;
+  std::mutex              _mutex;
+  std::condition_variable _notempty;
+  std::condition_variable _notfull;
+};
+
+#endif /* threadtools_h */